@@ -0,0 +1,71 @@
+#include "include/logfunc.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// 共有バックエンドのベンチマーク
+//
+// ライブラリごとに Logger を持つ構成を想定し、複数の Logger が別々のスレッドから
+// 同じファイルに書く。
+//   independent loggers : Logger ごとに自分でファイルを開く
+//   shared backend      : すべての Logger を 1 つの SharedBackend につなぐ
+// について、レコード/秒（全 Logger を閉じるまで）と、ファイルの記述子数・write の回数を表示する。
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_backend.cpp -I . -pthread -o bench_backend
+// 実行:   ./bench_backend [Logger 数] [1 Logger あたりのレコード数]
+// ============================================================
+
+namespace {
+
+const char* kPath = "bench_backend.txt";
+
+void run(const char* name, int loggers, int records, bool shared) {
+    std::remove(kPath);
+    auto backend = std::make_shared<Logger::SharedBackend>();
+    std::vector<std::unique_ptr<Logger>> fronts;
+    for (int i = 0; i < loggers; ++i) {
+        fronts.push_back(std::make_unique<Logger>());
+        if (shared) fronts.back()->attach_backend(backend);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < loggers; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < records; ++i) {
+                fronts[t]->log_to(kPath, "library=", t, " seq=", i, " event=request_done status=200\n");
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::size_t fds = shared ? backend->file_count() : static_cast<std::size_t>(loggers);
+    fronts.clear();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto total = static_cast<double>(loggers) * records;
+    auto writes = shared ? static_cast<double>(backend->write_calls()) : total;
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << (total / seconds) << " records/s"
+              << std::setw(6) << fds << " fds"
+              << std::setw(10) << writes << " writes\n";
+    std::remove(kPath);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int loggers = argc > 1 ? std::atoi(argv[1]) : 8;
+    int records = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+    std::cout << "loggers: " << loggers << ", records/logger: " << records << "\n";
+    run("independent loggers", loggers, records, false);
+    run("shared backend", loggers, records, true);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "include/logfunc.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ============================================================
+// 整形経路のベンチマーク
+//
+// 計測項目:
+//   1. JSON 文字列エスケープのスループット（スカラー / SSE2 / AVX2 / memcpy）
+//   2. 構造化ログ1行の整形コスト（ファイル書き込みを除く）
+//   3. 数値を含むテキスト1行の整形コスト（ostringstream / 高速経路）
+//   4. Logger::log_to の呼び出し形ごとのコスト（/dev/null への書き込みを含む）
+//      とフライトレコーダー有効時のコスト
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_format.cpp -I . -pthread -o bench_format
+// 実行:   ./bench_format [--quick]
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 最適化で計算が消されないようにする
+volatile std::size_t g_sink = 0;
+
+template<typename Fn>
+double time_ns_per_call(int calls, Fn&& fn) {
+    auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+}
+
+void print_row(const std::string& name, double ns, std::size_t bytes) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << ns << " ns"
+              << std::setw(10) << (bytes / ns) << " GB/s\n";
+}
+
+void bench_escape(int calls) {
+    std::cout << "\n[1] JSON string escaping\n";
+
+    std::string clean;
+    while (clean.size() < 4096) clean += "user=alice action=login path=/api/v1/items status=ok ";
+    clean.resize(4096);
+    std::string dirty = clean;
+    for (std::size_t i = 0; i < dirty.size(); i += 64) dirty[i] = '"';
+
+    struct Input { const char* name; const std::string* text; };
+    for (auto input : {Input{"clean 4KiB", &clean}, Input{"quote every 64B", &dirty}}) {
+        const std::string& s = *input.text;
+        std::string out;
+        out.reserve(s.size() * 2);
+
+        using namespace logfunc_internal;
+        auto run_kernel = [&](const char* kernel, FindJsonEscapeFn fn) {
+            double ns = time_ns_per_call(calls, [&] {
+                const char* p = s.data();
+                const char* end = p + s.size();
+                std::size_t hits = 0;
+                while ((p = fn(p, end)) != end) { ++p; ++hits; }
+                g_sink = g_sink + hits;
+            });
+            print_row(std::string(input.name) + " / scan " + kernel, ns, s.size());
+        };
+        run_kernel("scalar", &find_json_escape_scalar);
+#if LOGFUNC_SIMD_X86
+        run_kernel("sse2", &find_json_escape_sse2);
+        if (cpu_has_avx2()) run_kernel("avx2", &find_json_escape_avx2);
+#endif
+        double ns = time_ns_per_call(calls, [&] {
+            out.clear();
+            append_json_escaped(out, s);
+            g_sink = g_sink + out.size();
+        });
+        print_row(std::string(input.name) + " / append_json_escaped", ns, s.size());
+
+        ns = time_ns_per_call(calls, [&] {
+            out.assign(s.data(), s.size());
+            g_sink = g_sink + out.size();
+        });
+        print_row(std::string(input.name) + " / memcpy", ns, s.size());
+    }
+}
+
+void bench_structured(int calls) {
+    std::cout << "\n[2] structured line encoding (ns/line)\n";
+    using namespace logfunc_internal;
+    std::string user = "alice";
+    std::string path = "/api/v1/items?id=12345";
+
+    for (auto format : {StructuredFormat::Json, StructuredFormat::Logfmt, StructuredFormat::Text}) {
+        const char* name = format == StructuredFormat::Json ? "json"
+                         : format == StructuredFormat::Logfmt ? "logfmt" : "text";
+        double ns = time_ns_per_call(calls, [&] {
+            Field fields[] = {kv("user", user), kv("path", path), kv("status", 200),
+                              kv("latency_ms", 12.75), kv("ok", true)};
+            const Field* list[] = {&fields[0], &fields[1], &fields[2], &fields[3], &fields[4]};
+            std::string& out = format_buffer();
+            encode_structured(out, format, 1760000000123, "request done", list, 5);
+            g_sink = g_sink + out.size();
+        });
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << ns << " ns\n";
+    }
+}
+
+void bench_numbers(int calls) {
+    std::cout << "\n[3] numeric text line (ns/line)\n";
+    int frame = 0;
+    double x = 0.125;
+    float y = 3.14f;
+
+    double ns = time_ns_per_call(calls, [&] {
+        std::ostringstream oss;
+        oss << "frame " << ++frame << " x=" << x << " y=" << y << " id=" << 1234567890123LL << "\n";
+        g_sink = g_sink + oss.str().size();
+    });
+    std::cout << std::left << std::setw(40) << "ostringstream" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << ns << " ns\n";
+
+    for (int precision : {0, 6}) {
+        ns = time_ns_per_call(calls, [&] {
+            using logfunc_internal::append_text;
+            std::string& out = logfunc_internal::format_buffer();
+            append_text(out, "frame ", precision);
+            append_text(out, ++frame, precision);
+            append_text(out, " x=", precision);
+            append_text(out, x, precision);
+            append_text(out, " y=", precision);
+            append_text(out, y, precision);
+            append_text(out, " id=", precision);
+            append_text(out, 1234567890123LL, precision);
+            append_text(out, "\n", precision);
+            g_sink = g_sink + out.size();
+        });
+        std::string name = precision > 0 ? "fast path (precision 6)" : "fast path (shortest)";
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << ns << " ns\n";
+    }
+}
+
+void bench_call_shapes(int calls) {
+#ifdef _WIN32
+    const char* null_path = "NUL";
+#else
+    const char* null_path = "/dev/null";
+#endif
+    std::cout << "\n[4] Logger::log_to by call shape, incl. write to " << null_path << " (ns/call)\n";
+    Logger logger;
+    logger.set_metrics_enabled(false);
+    int i = 0;
+    std::string name = "sensor";
+
+    auto row = [](const char* label, double ns) {
+        std::cout << std::left << std::setw(40) << label << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << ns << " ns\n";
+    };
+    row("literal only", time_ns_per_call(calls, [&] {
+        logger.log_to(null_path, "input number:\n");
+    }));
+    // 長さはコンパイル時に決まるので、リテラルが長くても走査しない
+    row("literal only (120 chars)", time_ns_per_call(calls, [&] {
+        logger.log_to(null_path, "service started: listening on 0.0.0.0:8080, workers=8, "
+                                 "config=/etc/service/config.toml, log level=info, pid file\n");
+    }));
+    row("literals + numbers (stack buffer)", time_ns_per_call(calls, [&] {
+        ++i;
+        logger.log_to(null_path, "i=", i, " x=", 0.5 * i, "\n");
+    }));
+    row("with std::string (thread buffer)", time_ns_per_call(calls, [&] {
+        ++i;
+        logger.log_to(null_path, name, " i=", i, " x=", 0.5 * i, "\n");
+    }));
+    row("with manipulator (ostringstream)", time_ns_per_call(calls, [&] {
+        ++i;
+        logger.log_to(null_path, std::dec, "i=", i, " x=", 0.5 * i, "\n");
+    }));
+
+    Logger recorder;
+    recorder.set_metrics_enabled(false);
+    recorder.enable_flight_recorder();
+    row("flight recorder (no file I/O)", time_ns_per_call(calls, [&] {
+        ++i;
+        recorder.log_to(null_path, "i=", i, " x=", 0.5 * i, "\n");
+    }));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+    std::cout << "===========================================\n";
+    std::cout << "   logfunc formatting benchmark\n";
+    std::cout << "===========================================\n";
+#if LOGFUNC_SIMD_X86
+    std::cout << "simd: sse2" << (logfunc_internal::cpu_has_avx2() ? ", avx2" : "") << "\n";
+#else
+    std::cout << "simd: none (scalar)\n";
+#endif
+
+    bench_escape(quick ? 2000 : 200000);
+    bench_structured(quick ? 20000 : 1000000);
+    bench_numbers(quick ? 20000 : 1000000);
+    bench_call_shapes(quick ? 20000 : 500000);
+    return 0;
+}
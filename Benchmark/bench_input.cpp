@@ -0,0 +1,246 @@
+#include "include/logfunc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// ファイル入力経路（loginf / loginf_try / loginf_timeout / loginf_async）
+// のベンチマーク
+//
+// 計測項目:
+//   1. 変更→値取得レイテンシ: ライターが in.txt に追記してから
+//      read_input が返るまでの時間（イベント駆動 / ポーリング）
+//   2. loginf_try のコスト: ファイルが変化していない場合の1呼び出しあたりの時間
+//   3. 大きなファイルの取り込みスループット
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_input.cpp -I . -pthread -o bench_input
+// 実行:   ./bench_input [--quick]
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kInputPath = "bench_in.txt";
+const char* kHeader = "# Enter input values here (one per line)\n";
+
+// loginf が std::cout に出す進捗表示を計測中だけ捨てる
+class CoutSilencer {
+public:
+    CoutSilencer() : old_(std::cout.rdbuf(&null_)) {}
+    ~CoutSilencer() { std::cout.rdbuf(old_); }
+private:
+    struct NullBuf : std::streambuf {
+        int overflow(int c) override { return c; }
+    } null_;
+    std::streambuf* old_;
+};
+
+void write_header_only() {
+    std::ofstream file(kInputPath, std::ios::trunc);
+    file << kHeader;
+}
+
+void append_value(int value) {
+    std::ofstream file(kInputPath, std::ios::app);
+    file << value << "\n";
+}
+
+struct Stats {
+    double min_us = 0, p50_us = 0, p90_us = 0, p99_us = 0, max_us = 0, mean_us = 0;
+};
+
+Stats summarize(std::vector<double> samples) {
+    Stats s;
+    if (samples.empty()) return s;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) {
+        auto idx = static_cast<size_t>(q * (samples.size() - 1));
+        return samples[idx];
+    };
+    s.min_us = samples.front();
+    s.p50_us = at(0.50);
+    s.p90_us = at(0.90);
+    s.p99_us = at(0.99);
+    s.max_us = samples.back();
+    s.mean_us = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return s;
+}
+
+void print_latency_row(const std::string& name, const Stats& s) {
+    std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << s.min_us
+              << std::setw(10) << s.p50_us
+              << std::setw(10) << s.p90_us
+              << std::setw(10) << s.p99_us
+              << std::setw(10) << s.max_us
+              << std::setw(10) << s.mean_us << "\n";
+}
+
+// ライターが追記した時刻から reader が値を返すまでのレイテンシ（μs）を計測する
+template<typename Reader>
+std::vector<double> measure_latency(int iterations, Reader reader) {
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for (int i = 0; i < iterations; ++i) {
+        write_header_only();
+        // 直前の書き込みによる mtime 変化を確実に過去のものにする
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        Clock::time_point written_at;
+        std::thread writer([&written_at, i] {
+            // reader がファイル待機に入るまで待ってから追記する
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            written_at = Clock::now();
+            append_value(1000 + i);
+        });
+
+        int value = 0;
+        bool ok = reader(value);
+        auto done_at = Clock::now();
+        writer.join();
+
+        if (ok && value == 1000 + i) {
+            samples.push_back(
+                std::chrono::duration<double, std::micro>(done_at - written_at).count());
+        }
+    }
+    return samples;
+}
+
+void bench_change_latency(int event_iterations, int polling_iterations) {
+    std::cout << "\n[1] change-to-value latency (us)\n";
+    std::cout << std::left << std::setw(34) << "case" << std::right
+              << std::setw(10) << "min" << std::setw(10) << "p50" << std::setw(10) << "p90"
+              << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(10) << "mean" << "\n";
+
+    for (bool event_driven : {true, false}) {
+        log_set_event_driven_mode(event_driven);
+        int iterations = event_driven ? event_iterations : polling_iterations;
+        std::string mode = event_driven ? "event" : "polling";
+        std::vector<double> samples;
+
+        {
+            CoutSilencer silence;
+            samples = measure_latency(iterations, [](int& v) {
+                loginf(v);
+                return true;
+            });
+        }
+        print_latency_row("loginf / " + mode, summarize(samples));
+
+        {
+            CoutSilencer silence;
+            samples = measure_latency(iterations, [](int& v) {
+                return loginf_timeout(v, std::chrono::seconds(5));
+            });
+        }
+        print_latency_row("loginf_timeout / " + mode, summarize(samples));
+
+        {
+            CoutSilencer silence;
+            samples = measure_latency(iterations, [](int& v) {
+                v = loginf_async<int>().get();
+                return true;
+            });
+        }
+        print_latency_row("loginf_async<int>().get / " + mode, summarize(samples));
+    }
+    log_set_event_driven_mode(true);
+}
+
+// ファイルが変化していない状態での loginf_try の1回あたりのコスト（ns）
+void bench_try_unchanged(int calls) {
+    std::cout << "\n[2] loginf_try cost on unchanged file (ns/call)\n";
+
+    auto run = [calls](const char* name) {
+        int value = 0;
+        int hits = 0;
+        auto start = Clock::now();
+        for (int i = 0; i < calls; ++i) {
+            if (loginf_try(value)) ++hits;
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+        std::cout << std::left << std::setw(34) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << ns
+                  << "   (returned true " << hits << "/" << calls << ")\n";
+    };
+
+    write_header_only();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    run("header only (no value)");
+
+    append_value(7);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    run("value present");
+}
+
+// 大きな入力ファイル（コメント行の後ろに値が1つ）を取り込む速度
+void bench_ingest(int comment_lines) {
+    std::cout << "\n[3] ingest throughput for large file (" << comment_lines << " comment lines)\n";
+    {
+        std::ofstream file(kInputPath, std::ios::trunc);
+        std::string pad = "# padding line used to measure parser throughput ............\n";
+        for (int i = 0; i < comment_lines; ++i) file << pad;
+        file << "42\n";
+    }
+    std::error_code ec;
+    double mib = static_cast<double>(std::filesystem::file_size(kInputPath, ec)) / (1024.0 * 1024.0);
+
+    auto report = [mib](const std::string& name, Clock::duration elapsed) {
+        double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        std::cout << std::left << std::setw(34) << name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << ms << " ms"
+                  << std::setw(10) << (mib / (ms / 1000.0)) << " MiB/s\n";
+    };
+
+    for (bool event_driven : {true, false}) {
+        log_set_event_driven_mode(event_driven);
+        std::string mode = event_driven ? "event" : "polling";
+        int value = 0;
+        auto start = Clock::now();
+        {
+            CoutSilencer silence;
+            loginf(value);
+        }
+        report("loginf / " + mode, Clock::now() - start);
+    }
+    log_set_event_driven_mode(true);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int value = 0;
+    auto start = Clock::now();
+    loginf_try(value);
+    report("loginf_try (cold)", Clock::now() - start);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+    std::cout << "===========================================\n";
+    std::cout << "   logfunc file-input benchmark\n";
+    std::cout << "===========================================\n";
+    std::cout << "native file watch support: "
+              << (log_has_native_file_watch_support() ? "yes" : "no") << "\n";
+
+    init_input(kInputPath);
+
+    bench_change_latency(quick ? 5 : 50, quick ? 3 : 20);
+    bench_try_unchanged(quick ? 10000 : 200000);
+    bench_ingest(quick ? 20000 : 500000);
+
+    std::remove(kInputPath);
+    std::remove("log.txt");
+    return 0;
+}
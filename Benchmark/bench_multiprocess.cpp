@@ -0,0 +1,108 @@
+#include "include/logfunc.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// ============================================================
+// 複数プロセスから同じファイルへ書き込むベンチマーク（POSIX のみ）
+//
+// プロセスごとに別の Logger で同じファイルに追記し、全体のレコード/秒と
+// 壊れたレコード（他のレコードと混ざった・欠けた）の数を表示する。
+//   default          : 通常のファイル出力
+//   shared append    : レコードごとに 1 回の O_APPEND write
+//   shared + flock   : すべてのレコードをファイルロック付きで書く（atomic_write_max = 0）
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_multiprocess.cpp -I . -pthread -o bench_multiprocess
+// 実行:   ./bench_multiprocess [プロセス数] [1プロセスあたりのレコード数]
+// ============================================================
+
+#ifdef _WIN32
+int main() {
+    std::cout << "bench_multiprocess requires fork(); skipped on Windows\n";
+    return 0;
+}
+#else
+
+namespace {
+
+const char* kPath = "bench_multiprocess.txt";
+
+// 行の中身を検証できるよう、プロセス番号と長さを埋め込む
+std::string payload(int proc, int i) {
+    return std::string(static_cast<std::size_t>(64 + (i * 37) % 512), static_cast<char>('a' + proc % 26));
+}
+
+// 完全な行として読めなかったレコードの数
+int count_damaged_records(int processes, int records) {
+    std::ifstream file(kPath);
+    std::string line;
+    int intact = 0;
+    while (std::getline(file, line)) {
+        int proc = -1, i = -1, len = -1, consumed = 0;
+        if (std::sscanf(line.c_str(), "p=%d i=%d len=%d %n", &proc, &i, &len, &consumed) == 3 &&
+            proc >= 0 && proc < processes && line.substr(static_cast<std::size_t>(consumed)) == payload(proc, i)) {
+            ++intact;
+        }
+    }
+    return processes * records - intact;
+}
+
+void run(const char* name, int processes, int records, int mode) {
+    std::remove(kPath);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> children;
+    for (int p = 0; p < processes; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            Logger logger;
+            if (mode > 0) {
+                Logger::SharedAppendOptions options;
+                if (mode == 2) options.atomic_write_max = 0;
+                logger.enable_shared_append(options);
+            }
+            for (int i = 0; i < records; ++i) {
+                auto text = payload(p, i);
+                logger.log_to(kPath, "p=", p, " i=", i, " len=", text.size(), " ", text, "\n");
+            }
+            logger.close_all();
+            std::_Exit(0);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << (processes * records / seconds) << " records/s"
+              << std::setw(10) << count_damaged_records(processes, records) << " damaged\n";
+    std::remove(kPath);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int processes = argc > 1 ? std::atoi(argv[1]) : 4;
+    int records = argc > 2 ? std::atoi(argv[2]) : 20000;
+
+    std::cout << "processes: " << processes << ", records/process: " << records << "\n";
+    run("default", processes, records, 0);
+    run("shared append", processes, records, 1);
+    run("shared + flock", processes, records, 2);
+    return 0;
+}
+
+#endif
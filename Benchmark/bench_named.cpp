@@ -0,0 +1,96 @@
+#include "include/logfunc.h"
+#include "include/logfunc_named.h"
+#include "include/logfunc_control.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// ============================================================
+// 名前付きロガーのベンチマーク
+//
+//   LOGN disabled        : レベルが無効な呼び出し 1 回のコスト
+//   logto per module     : モジュールごとのファイルに logto する従来の方法（止められない）
+//   LOGN enabled         : 有効なレベルで書く呼び出し 1 回のコスト
+//   set_level (N loggers): 親のレベルを変えて N 個の子孫に伝えるまでの時間
+//   control file reload  : 制御ファイルを保存してからレベルが変わるまでの時間
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_named.cpp -I . -pthread -o bench_named
+// 実行:   ./bench_named [呼び出し回数]
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kPath = "bench_named.txt";
+const char* kControlPath = "bench_named.ctl";
+
+NamedLogger& net_log = get_logger("bench.net");
+
+void print_ns(const char* name, Clock::time_point start, int calls) {
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << ns << " ns/call\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::cout << "calls: " << calls << "\n";
+    std::remove(kPath);
+
+    Logger logger;
+    log_set_target("bench", kPath, &logger);
+
+    log_set_level("bench.net", LogLevel::Info);
+    auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        LOGN(net_log, Debug, "packet seq=", i, " bytes=", i % 1500, "\n");
+    }
+    print_ns("LOGN disabled", start, calls);
+
+    start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        logger.log_to(kPath, "packet seq=", i, " bytes=", i % 1500, "\n");
+    }
+    print_ns("logto per module", start, calls);
+
+    log_set_level("bench.net", LogLevel::Debug);
+    start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        LOGN(net_log, Debug, "packet seq=", i, " bytes=", i % 1500, "\n");
+    }
+    print_ns("LOGN enabled", start, calls);
+    logger.close_all();
+    std::remove(kPath);
+
+    const int children = 1000;
+    for (int i = 0; i < children; ++i) {
+        get_logger("bench.tree.m" + std::to_string(i));
+    }
+    start = Clock::now();
+    log_set_level("bench.tree", LogLevel::Warn);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    std::cout << std::left << std::setw(24) << "set_level (1000 loggers)" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << us << " us\n";
+
+    std::remove(kControlPath);
+    LogControl control(logger);
+    control.start(kControlPath);
+    start = Clock::now();
+    std::ofstream(kControlPath) << "level bench.net trace\n";
+    while (!net_log.enabled(LogLevel::Trace) && Clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::yield();
+    }
+    us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    std::cout << std::left << std::setw(24) << "control file reload" << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << us << " us\n";
+    control.stop();
+    std::remove(kControlPath);
+    return 0;
+}
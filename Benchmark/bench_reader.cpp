@@ -0,0 +1,91 @@
+#include "include/logfunc.h"
+#include "include/logfunc_reader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// ============================================================
+// ログリーダーのスキャン速度ベンチマーク
+//
+// 同じファイルを std::getline + find（1スレッド）と LogReader（スレッド数を変える）で
+// 検索し、MiB/s を表示する。2回目以降はページキャッシュに載った状態の計測になる。
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_reader.cpp -I . -pthread -o bench_reader
+// 実行:   ./bench_reader [--quick]
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kPath = "bench_reader.txt";
+
+void print_row(const std::string& name, double mib, double seconds, std::size_t hits) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << (mib / seconds) << " MiB/s"
+              << std::setw(10) << hits << " hits\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+    int records = quick ? 200000 : 5000000;
+
+    std::remove(kPath);
+    {
+        Logger logger;
+        for (int i = 0; i < records; ++i) {
+            logger.log_to(kPath, i % 101 == 0 ? "ERROR" : "INFO", " request id=", i,
+                          " status=", i % 101 == 0 ? 500 : 200, " path=/api/v1/items\n");
+        }
+    }
+    std::error_code ec;
+    double mib = static_cast<double>(std::filesystem::file_size(kPath, ec)) / (1024.0 * 1024.0);
+
+    std::cout << "===========================================\n";
+    std::cout << "   logfunc log reader benchmark\n";
+    std::cout << "===========================================\n";
+    std::cout << "file: " << std::fixed << std::setprecision(1) << mib << " MiB, hardware threads: "
+              << std::thread::hardware_concurrency() << "\n\n";
+
+    // 比較用: 行ごとに読んで部分文字列を探す
+    {
+        auto start = Clock::now();
+        std::ifstream file(kPath);
+        std::string line;
+        std::size_t hits = 0;
+        while (std::getline(file, line)) {
+            if (line.find("status=500") != std::string::npos) ++hits;
+        }
+        print_row("getline + find", mib, std::chrono::duration<double>(Clock::now() - start).count(), hits);
+    }
+
+    LogReader reader(kPath);
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        LogQuery query;
+        query.contains = "status=500";
+        query.threads = threads;
+        auto start = Clock::now();
+        std::size_t hits = reader.count(query);
+        print_row("LogReader contains x" + std::to_string(threads), mib,
+                  std::chrono::duration<double>(Clock::now() - start).count(), hits);
+    }
+    for (unsigned threads : {1u, 4u}) {
+        LogQuery query;
+        query.level = "ERROR";
+        query.threads = threads;
+        auto start = Clock::now();
+        std::size_t hits = reader.count(query);
+        print_row("LogReader level x" + std::to_string(threads), mib,
+                  std::chrono::duration<double>(Clock::now() - start).count(), hits);
+    }
+
+    std::remove(kPath);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "include/logfunc.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include "include/logfunc_socket.h"
+#include <poll.h>
+#endif
+
+// ============================================================
+// Unix ドメインソケットシンクのベンチマーク（POSIX のみ）
+//
+// ローカルのデータグラムソケットを syslog デーモンの代わりに受信側とし、
+//   per-record send : レコードごとに呼び出し側のスレッドで send()
+//   socket sink     : unix_socket_sink（送信スレッドが sendmmsg でまとめて送る）
+// について、呼び出し側の所要時間と、受信側に全レコードが届くまでの時間を表示する。
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_socket.cpp -I . -pthread -o bench_socket
+// 実行:   ./bench_socket [レコード数]
+// ============================================================
+
+#ifdef _WIN32
+int main() {
+    std::cout << "bench_socket requires Unix domain sockets; skipped on Windows\n";
+    return 0;
+}
+#else
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kSocketPath = "bench_socket.sock";
+
+// 届いたデータグラムを数えるだけの受信側
+class Receiver {
+public:
+    Receiver() {
+        ::unlink(kSocketPath);
+        fd_ = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, kSocketPath, sizeof(addr.sun_path) - 1);
+        if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::perror("bind");
+            std::exit(1);
+        }
+        int size = 4 * 1024 * 1024;
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        thread_ = std::thread([this] {
+            char buf[4096];
+            while (!stop_) {
+                pollfd pfd{fd_, POLLIN, 0};
+                if (::poll(&pfd, 1, 20) > 0 && ::recv(fd_, buf, sizeof(buf), 0) >= 0) {
+                    received_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    ~Receiver() {
+        stop_ = true;
+        thread_.join();
+        ::close(fd_);
+        ::unlink(kSocketPath);
+    }
+
+    void wait_for(std::size_t count) const {
+        while (received_.load(std::memory_order_relaxed) < count) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    int fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::atomic<std::size_t> received_{0};
+    std::thread thread_;
+};
+
+void print_row(const char* name, int records, double caller, double delivered) {
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << (records / caller) << " records/s (caller)"
+              << std::setw(12) << (records / delivered) << " records/s (delivered)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int records = argc > 1 ? std::atoi(argv[1]) : 200000;
+    std::cout << "records: " << records << "\n";
+
+    {
+        Receiver receiver;
+        int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, kSocketPath, sizeof(addr.sun_path) - 1);
+        ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        auto start = Clock::now();
+        for (int i = 0; i < records; ++i) {
+            std::string record = "request id=" + std::to_string(i) + " status=200 path=/api/v1/items";
+            ::send(fd, record.data(), record.size(), 0);
+        }
+        double caller = std::chrono::duration<double>(Clock::now() - start).count();
+        receiver.wait_for(static_cast<std::size_t>(records));
+        double delivered = std::chrono::duration<double>(Clock::now() - start).count();
+        ::close(fd);
+        print_row("per-record send", records, caller, delivered);
+    }
+
+    {
+        Receiver receiver;
+        SocketSinkOptions options;
+        options.socket_path = kSocketPath;
+        options.buffer_bytes = 64 * 1024 * 1024;   // 比較のため捨てないようにする
+        Logger logger;
+        logger.set_sink("syslog", unix_socket_sink(options));
+        auto start = Clock::now();
+        for (int i = 0; i < records; ++i) {
+            logger.log_to("syslog", "request id=", i, " status=200 path=/api/v1/items\n");
+        }
+        double caller = std::chrono::duration<double>(Clock::now() - start).count();
+        logger.flush();
+        receiver.wait_for(static_cast<std::size_t>(records));
+        double delivered = std::chrono::duration<double>(Clock::now() - start).count();
+        print_row("socket sink", records, caller, delivered);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include "include/logfunc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+// ============================================================
+// 起動直後のコストのベンチマーク
+//
+// 短命な CLI ツールを想定し、新しい Logger ごとに次の所要時間（中央値）を表示する。
+//   first log            : Logger の構築から最初のレコードを書き終えるまで
+//   first try_read_input : 入力ファイルが無い状態での最初の try_read_input（テンプレートの作成を含む）
+//   next try_read_input  : 2回目以降の try_read_input（存在確認は済んでいる）
+//   read_input (ready)   : 値が既に書かれている入力ファイルの read_input
+//   process to first log : プロセス起動から最初のレコードを書いて終了するまで（POSIX のみ）
+//
+// ビルド: g++ -std=c++17 -O2 Benchmark/bench_startup.cpp -I . -pthread -o bench_startup
+// 実行:   ./bench_startup [繰り返し回数]
+// ============================================================
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kLogPath = "bench_startup_log.txt";
+const char* kInputPath = "bench_startup_in.txt";
+
+template<typename Fn>
+double median_us(int iterations, Fn&& fn) {
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(iterations));
+    for (int i = 0; i < iterations; ++i) {
+        samples.push_back(fn());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+double elapsed_us(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+void print_row(const char* name, double us) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << us << " us\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--child") == 0) {
+        init_log(kLogPath);
+        logff("started pid=", 1, "\n");
+        return 0;
+    }
+
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+    std::cout << "iterations: " << iterations << "\n";
+
+    print_row("first log", median_us(iterations, [] {
+        std::remove(kLogPath);
+        auto start = Clock::now();
+        Logger logger;
+        logger.set_log_path(kLogPath);
+        logger.log("started\n");
+        return elapsed_us(start);
+    }));
+
+    print_row("first try_read_input", median_us(iterations, [] {
+        std::remove(kInputPath);
+        Logger logger;
+        logger.set_input_path(kInputPath);
+        int value = 0;
+        auto start = Clock::now();
+        logger.try_read_input(value);
+        return elapsed_us(start);
+    }));
+
+    {
+        Logger logger;
+        logger.set_input_path(kInputPath);
+        int value = 0;
+        logger.try_read_input(value);
+        print_row("next try_read_input", median_us(iterations, [&] {
+            auto start = Clock::now();
+            // キャッシュ期間内は再読み込みしないため、存在確認の分だけが見える
+            logger.try_read_input(value);
+            return elapsed_us(start);
+        }));
+    }
+
+    {
+        std::ofstream(kInputPath) << "7\n";
+        print_row("read_input (ready)", median_us(iterations, [] {
+            Logger logger;
+            logger.set_input_path(kInputPath);
+            int value = 0;
+            std::streambuf* saved = std::cout.rdbuf(nullptr);  // 待機メッセージを出さない
+            auto start = Clock::now();
+            logger.read_input(value);
+            double us = elapsed_us(start);
+            std::cout.rdbuf(saved);
+            return us;
+        }));
+    }
+
+#ifndef _WIN32
+    print_row("process to first log", median_us(std::max(1, iterations / 10), [&] {
+        std::remove(kLogPath);
+        char child_flag[] = "--child";
+        char* child_argv[] = {argv[0], child_flag, nullptr};
+        pid_t pid = 0;
+        auto start = Clock::now();
+        if (::posix_spawn(&pid, argv[0], nullptr, nullptr, child_argv, environ) != 0) {
+            return 0.0;
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        return elapsed_us(start);
+    }));
+#endif
+
+    std::remove(kLogPath);
+    std::remove(kInputPath);
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include "include/logfunc_compress.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// 圧縮シンクのテスト
+//
+// 書き込んだファイルを zlib で展開して元のレコードと比較する。
+//
+// ビルド:
+//   g++ -std=c++17 Test/test_compress.cpp -I . -pthread -lz -o test_compress
+// 実行:
+//   ./test_compress [テスト名の一部]
+// ============================================================
+
+namespace {
+
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<TestCase>& test_registry() {
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+struct TestFailure {
+    std::string message;
+};
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+// 連結された gzip メンバーを順に展開する。末尾が未完了のメンバーでも、
+// そこまでに出力された分を返す
+std::string gunzip(const std::string& data) {
+    std::string out;
+    std::size_t offset = 0;
+    while (offset < data.size()) {
+        z_stream zs{};
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            throw TestFailure{"inflateInit2 failed"};
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data() + offset));
+        zs.avail_in = static_cast<uInt>(data.size() - offset);
+        int ret = Z_OK;
+        char buf[16384];
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(buf);
+            zs.avail_out = sizeof(buf);
+            ret = inflate(&zs, Z_NO_FLUSH);
+            out.append(buf, sizeof(buf) - zs.avail_out);
+        } while (ret == Z_OK && zs.avail_in > 0);
+        if (ret == Z_OK && zs.avail_out == 0) {
+            // 出力バッファが埋まっただけなら続きを取り出す
+            do {
+                zs.next_out = reinterpret_cast<Bytef*>(buf);
+                zs.avail_out = sizeof(buf);
+                ret = inflate(&zs, Z_NO_FLUSH);
+                out.append(buf, sizeof(buf) - zs.avail_out);
+            } while (ret == Z_OK && zs.avail_out == 0);
+        }
+        std::size_t consumed = (data.size() - offset) - zs.avail_in;
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END) {
+            break;  // 書き込み途中のメンバー
+        }
+        offset += consumed;
+    }
+    return out;
+}
+
+} // namespace
+
+#define TEST(name) void name(); \
+    struct name##_register { name##_register() { test_registry().push_back({#name, &name}); } } name##_instance; \
+    void name()
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        throw TestFailure{std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #cond ") failed"}; \
+    } \
+} while (0)
+
+// ============================================================
+
+TEST(test_gzip_roundtrip) {
+    const std::string path = "compress_test.log.gz";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_sink(path, compressed_sink({LogCompression::Gzip, 6}));
+
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+        logger.log_to(path, "record ", i, " value ", i * 0.25, "\n");
+        std::ostringstream oss;
+        oss << "record " << i << " value " << i * 0.25 << "\n";
+        expected += oss.str();
+    }
+    logger.close_all();
+
+    std::string compressed = read_file(path);
+    CHECK(!compressed.empty());
+    CHECK(compressed.size() < expected.size() / 2);
+    CHECK(gunzip(compressed) == expected);
+    std::remove(path.c_str());
+}
+
+TEST(test_gzip_partial_file_readable) {
+    const std::string path = "compress_partial.log.gz";
+    std::remove(path.c_str());
+
+    Logger logger;
+    CompressionOptions options;
+    options.flush_bytes = 1024;
+    logger.set_sink(path, compressed_sink(options));
+
+    std::string expected;
+    for (int i = 0; i < 500; ++i) {
+        std::string line = "partial line " + std::to_string(i) + "\n";
+        logger.log_to(path, line);
+        expected += line;
+    }
+    logger.flush();
+
+    // 閉じる前でも flush() までに書いたレコードはすべて展開できる
+    CHECK(gunzip(read_file(path)) == expected);
+
+    // flush_bytes ごとの区切りだけでも、直近の区切りまでは読める
+    for (int i = 0; i < 500; ++i) {
+        logger.log_to(path, "more ", i, "\n");
+    }
+    std::string partial = gunzip(read_file(path));
+    CHECK(partial.size() > expected.size());
+    CHECK(partial.compare(0, expected.size(), expected) == 0);
+
+    logger.close_all();
+    std::remove(path.c_str());
+}
+
+TEST(test_gzip_reopen_appends_member) {
+    const std::string path = "compress_reopen.log.gz";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_sink(path, compressed_sink());
+    logger.log_to(path, "before close\n");
+    logger.close_all();
+    {
+        auto stream = logger.get_locked_stream(path);
+        stream << "locked " << 42 << "\n";
+    }
+    logger.close_all();
+
+    CHECK(gunzip(read_file(path)) == "before close\nlocked 42\n");
+    std::remove(path.c_str());
+}
+
+TEST(test_gzip_concurrent_writers) {
+    const std::string path = "compress_concurrent.log.gz";
+    std::remove(path.c_str());
+
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 1000;
+    Logger logger;
+    CompressionOptions options;
+    options.flush_bytes = 4096;
+    logger.set_sink(path, compressed_sink(options));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kRecords; ++i) {
+                logger.log_to(path, "t=", t, " i=", i, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.close_all();
+
+    // 各スレッドのレコードが欠けず、スレッド内の順序が保たれている
+    std::string text = gunzip(read_file(path));
+    std::vector<int> next(kThreads, 0);
+    std::size_t pos = 0;
+    int lines = 0;
+    while (pos < text.size()) {
+        std::size_t end = text.find('\n', pos);
+        CHECK(end != std::string::npos);
+        int t = -1, i = -1;
+        CHECK(std::sscanf(text.c_str() + pos, "t=%d i=%d", &t, &i) == 2);
+        CHECK(t >= 0 && t < kThreads && next[t] == i);
+        next[t] += 1;
+        lines += 1;
+        pos = end + 1;
+    }
+    CHECK(lines == kThreads * kRecords);
+    std::remove(path.c_str());
+}
+
+TEST(test_gzip_parallel_blocks) {
+    const std::string path = "compress_parallel.log.gz";
+    std::remove(path.c_str());
+
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 5000;
+    Logger logger;
+    CompressionOptions options;
+    options.flush_bytes = 8 * 1024;
+    options.threads = 3;
+    logger.set_sink(path, compressed_sink(options));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kRecords; ++i) {
+                logger.log_to(path, "t=", t, " i=", i, " parallel block payload\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    // flush() 後は閉じる前でも全レコードを展開でき、ブロックの順序も保たれている
+    std::string text = gunzip(read_file(path));
+    std::vector<int> next(kThreads, 0);
+    std::size_t pos = 0;
+    int lines = 0;
+    while (pos < text.size()) {
+        std::size_t end = text.find('\n', pos);
+        CHECK(end != std::string::npos);
+        int t = -1, i = -1;
+        CHECK(std::sscanf(text.c_str() + pos, "t=%d i=%d", &t, &i) == 2);
+        CHECK(t >= 0 && t < kThreads && next[t] == i);
+        next[t] += 1;
+        lines += 1;
+        pos = end + 1;
+    }
+    CHECK(lines == kThreads * kRecords);
+
+    logger.log_to(path, "tail\n");
+    logger.close_all();
+    std::string all = gunzip(read_file(path));
+    CHECK(all.size() == text.size() + 5);
+    CHECK(all.compare(all.size() - 5, 5, "tail\n") == 0);
+    std::remove(path.c_str());
+}
+
+TEST(test_compression_available) {
+    CHECK(compression_available(LogCompression::Gzip));
+#ifndef LOGFUNC_WITH_ZSTD
+    CHECK(!compression_available(LogCompression::Zstd));
+    bool threw = false;
+    try {
+        compressed_sink({LogCompression::Zstd});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+#endif
+#ifndef LOGFUNC_WITH_LZ4
+    CHECK(!compression_available(LogCompression::Lz4));
+#endif
+}
+
+// ============================================================
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    int test_count = 0;
+    int pass_count = 0;
+    for (const auto& test : test_registry()) {
+        if (filter && std::strstr(test.name, filter) == nullptr) {
+            continue;
+        }
+        ++test_count;
+        std::cout << "Running: " << test.name << std::endl;
+        try {
+            test.fn();
+            ++pass_count;
+            std::cout << "  [PASSED]\n";
+        } catch (const TestFailure& failure) {
+            std::cout << "  [FAILED] " << failure.message << "\n";
+        } catch (const std::exception& e) {
+            std::cout << "  [FAILED] exception: " << e.what() << "\n";
+        }
+    }
+
+    std::cout << "\nResults: " << pass_count << "/" << test_count << " tests passed\n";
+    return pass_count == test_count ? 0 : 1;
+}
@@ -0,0 +1,2753 @@
+#include "include/logfunc.h"
+#include "include/logfunc_reader.h"
+#include "include/logfunc_named.h"
+#include "include/logfunc_control.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+#ifndef _WIN32
+#include "include/logfunc_shm.h"
+#include "include/logfunc_socket.h"
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// ============================================================
+// logfunc 自動テスト
+//
+// 人手による in.txt の編集を必要とせず、入力ファイルはヘルパースレッドから
+// 書き換える。TSan / ASan でもそのまま実行できる。
+//
+// ビルド:
+//   g++ -std=c++17 Test/test_unit.cpp -I . -pthread -o test_unit
+//   g++ -std=c++17 -g -O1 -fsanitize=thread  Test/test_unit.cpp -I . -pthread -o test_unit_tsan
+//   g++ -std=c++17 -g -O1 -fsanitize=address Test/test_unit.cpp -I . -pthread -o test_unit_asan
+// 実行:
+//   ./test_unit [テスト名の一部]
+// ============================================================
+
+namespace {
+
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<TestCase>& test_registry() {
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+struct TestFailure {
+    std::string message;
+};
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+std::vector<std::string> read_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void write_file(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+} // namespace
+
+#define TEST(name) void name(); \
+    struct name##_register { name##_register() { test_registry().push_back({#name, &name}); } } name##_instance; \
+    void name()
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        throw TestFailure{std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #cond ") failed"}; \
+    } \
+} while (0)
+
+// ============================================================
+// 基本API
+// ============================================================
+
+TEST(test_logff_output) {
+    init_log("test_log.txt");
+
+    logff("Test value: ", 42, "\n");
+    logff("Float: ", 3.14f, "\n");
+    logff("Multiple: ", 1, " ", 2, " ", 3, "\n");
+    log_flush();
+
+    std::string content = read_file("test_log.txt");
+    CHECK(content.find("Test value: 42") != std::string::npos);
+    CHECK(content.find("Float: 3.14") != std::string::npos);
+    CHECK(content.find("Multiple: 1 2 3") != std::string::npos);
+}
+
+TEST(test_logto_output) {
+    logto("custom_test.txt", "Custom output: ", 100, "\n");
+    log_flush("custom_test.txt");
+
+    auto lines = read_lines("custom_test.txt");
+    CHECK(!lines.empty());
+    CHECK(lines[0].find("Custom output: 100") != std::string::npos);
+}
+
+TEST(test_loginf_try_nonblocking) {
+    log_reset();
+    init_input("test_input.txt");
+    write_file("test_input.txt", "123\n");
+
+    int value = 0;
+    CHECK(loginf_try(value));
+    CHECK(value == 123);
+}
+
+TEST(test_loginf_try_empty) {
+    log_reset();
+    init_input("nonexistent_file_test.txt");
+    std::remove("nonexistent_file_test.txt");
+
+    // ファイルはテンプレートのみで作成されるので値は読めない
+    int value = 999;
+    CHECK(!loginf_try(value));
+}
+
+TEST(test_loginf_timeout) {
+    log_reset();
+    init_input("timeout_test.txt");
+    write_file("timeout_test.txt", "456\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    int value = 0;
+    CHECK(loginf_timeout(value, std::chrono::milliseconds(1000)));
+    CHECK(value == 456);
+}
+
+TEST(test_comment_skip) {
+    log_reset();
+    init_input("comment_test.txt");
+    write_file("comment_test.txt",
+               "# This is a comment\n   # Another comment with spaces\n\n789\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    int value = 0;
+    CHECK(loginf_try(value));
+    CHECK(value == 789);
+}
+
+TEST(test_float_input) {
+    log_reset();
+    init_input("float_test.txt");
+    write_file("float_test.txt", "3.14159\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    float value = 0.0f;
+    CHECK(loginf_try(value));
+    CHECK(value > 3.14f && value < 3.15f);
+}
+
+TEST(test_double_input) {
+    log_reset();
+    init_input("double_test.txt");
+    write_file("double_test.txt", "2.718281828\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    double value = 0.0;
+    CHECK(loginf_try(value));
+    CHECK(value > 2.718 && value < 2.719);
+}
+
+TEST(test_silent_mode) {
+    log_set_silent_mode(true);
+    CHECK(log_is_silent_mode());
+    log_set_silent_mode(false);
+    CHECK(!log_is_silent_mode());
+    log_set_silent_mode(true);
+}
+
+TEST(test_close_all) {
+    log_reset();
+    init_log("test_log.txt");
+    logff("Before close\n");
+    log_close_all();
+    logff("After close\n");
+    log_flush();
+
+    std::string content = read_file("test_log.txt");
+    CHECK(content.find("Before close") != std::string::npos);
+    CHECK(content.find("After close") != std::string::npos);
+}
+
+TEST(test_event_driven_mode) {
+    CHECK(log_is_event_driven_mode());
+    log_set_event_driven_mode(false);
+    CHECK(!log_is_event_driven_mode());
+    log_set_event_driven_mode(true);
+    CHECK(log_is_event_driven_mode());
+}
+
+TEST(test_native_file_watch_support) {
+    bool has_support = log_has_native_file_watch_support();
+#if defined(_WIN32) || defined(__linux__) || defined(__APPLE__)
+    CHECK(has_support);
+#endif
+    std::cout << "    Native file watch support: " << (has_support ? "yes" : "no") << "\n";
+}
+
+TEST(test_log_reset) {
+    init_log("custom_log.txt");
+    init_input("custom_input.txt");
+    log_set_silent_mode(false);
+    log_set_event_driven_mode(false);
+
+    log_reset();
+
+    CHECK(log_is_silent_mode());
+    CHECK(log_is_event_driven_mode());
+}
+
+// ============================================================
+// ヘルパースレッドで入力ファイルを更新する非同期入力テスト
+// ============================================================
+
+namespace {
+
+// reader が待機状態に入った後で値を追記するヘルパー
+std::thread write_value_later(const std::string& path, int value,
+                              std::chrono::milliseconds delay = std::chrono::milliseconds(50)) {
+    return std::thread([path, value, delay] {
+        std::this_thread::sleep_for(delay);
+        std::ofstream file(path, std::ios::app);
+        file << value << "\n";
+    });
+}
+
+void check_read_input_driven_by_writer(bool event_driven) {
+    const std::string path = event_driven ? "auto_in_event.txt" : "auto_in_polling.txt";
+    write_file(path, "# waiting\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+    logger.set_event_driven_mode(event_driven);
+
+    auto writer = write_value_later(path, 314);
+    int value = 0;
+    logger.read_input(value);
+    writer.join();
+    CHECK(value == 314);
+
+    write_file(path, "# waiting\n");
+    writer = write_value_later(path, 271);
+    value = 0;
+    bool ok = logger.read_input_timeout(value, std::chrono::milliseconds(5000));
+    writer.join();
+    CHECK(ok);
+    CHECK(value == 271);
+
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+TEST(test_read_input_event_driven_writer_thread) {
+    check_read_input_driven_by_writer(true);
+}
+
+TEST(test_read_input_polling_writer_thread) {
+    check_read_input_driven_by_writer(false);
+}
+
+TEST(test_read_input_timeout_expires) {
+    const std::string path = "auto_in_timeout.txt";
+    write_file(path, "# no value\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+
+    int value = -1;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!logger.read_input_timeout(value, std::chrono::milliseconds(150)));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(150));
+    CHECK(value == -1);
+
+    std::remove(path.c_str());
+}
+
+TEST(test_read_input_async_future_writer_thread) {
+    const std::string path = "auto_in_future.txt";
+    write_file(path, "# waiting\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+
+    auto future = logger.read_input_async<int>();
+    auto writer = write_value_later(path, 77);
+    CHECK(future.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    CHECK(future.get() == 77);
+    writer.join();
+
+    std::remove(path.c_str());
+}
+
+TEST(test_read_input_async_callback_writer_thread) {
+    const std::string path = "auto_in_callback.txt";
+    write_file(path, "# waiting\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+    double received = 0.0;
+
+    logger.read_input_async<double>([&](double value) {
+        std::lock_guard<std::mutex> lock(mtx);
+        received = value;
+        done = true;
+        cv.notify_all();
+    });
+
+    auto writer = write_value_later(path, 5);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        CHECK(cv.wait_for(lock, std::chrono::seconds(10), [&] { return done; }));
+    }
+    writer.join();
+    CHECK(received == 5.0);
+
+    std::remove(path.c_str());
+}
+
+TEST(test_try_read_input_sees_update) {
+    const std::string path = "auto_in_try.txt";
+    write_file(path, "# waiting\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+
+    int value = 0;
+    CHECK(!logger.try_read_input(value));
+
+    auto writer = write_value_later(path, 9, std::chrono::milliseconds(20));
+    bool ok = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!ok && std::chrono::steady_clock::now() < deadline) {
+        ok = logger.try_read_input(value);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    writer.join();
+    CHECK(ok);
+    CHECK(value == 9);
+
+    std::remove(path.c_str());
+}
+
+TEST(test_input_file_checked_once_per_path) {
+    namespace fs = std::filesystem;
+    const std::string path = "auto_in_lazy.txt";
+    const std::string other = "auto_in_lazy2.txt";
+    std::remove(path.c_str());
+    std::remove(other.c_str());
+
+    Logger logger;
+    logger.set_input_path(path);
+    CHECK(!fs::exists(path));  // 構築と設定だけではファイルに触れない
+
+    int value = 0;
+    CHECK(!logger.try_read_input(value));
+    CHECK(read_file(path) == "# Enter input values here (one per line)\n");
+
+    // 確認済みのパスは作り直さない
+    std::remove(path.c_str());
+    CHECK(!logger.try_read_input(value));
+    logger.ensure_input_file_exists();
+    CHECK(!fs::exists(path));
+
+    // パスを変えると改めて確認する
+    logger.set_input_path(other);
+    logger.ensure_input_file_exists();
+    CHECK(fs::exists(other));
+
+    std::remove(other.c_str());
+}
+
+TEST(test_read_input_present_value_skips_watcher) {
+    const std::string path = "auto_in_present.txt";
+    write_file(path, "# ready\n42\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+    int value = 0;
+    logger.read_input(value);
+    CHECK(value == 42);
+    value = 0;
+    CHECK(logger.read_input_timeout(value, std::chrono::milliseconds(1000)));
+    CHECK(value == 42);
+
+    auto m = logger.get_metrics();
+    CHECK(m.input_reparses == 2);
+    CHECK(m.watcher_events == 0);
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// 並行書き込みのストレステスト（行の欠落・破損がないこと）
+// ============================================================
+
+namespace {
+
+constexpr int kStressThreads = 8;
+constexpr int kStressRecords = 500;
+
+std::string stress_payload(int tid, int i) {
+    return std::string(static_cast<size_t>((i * 7) % 200), static_cast<char>('a' + tid % 26));
+}
+
+// "t=<tid> i=<i> len=<n> <payload>" 形式の行がすべて1回ずつ揃っているか検証する
+void check_stress_lines(const std::vector<std::string>& lines, int threads, int records) {
+    CHECK(lines.size() == static_cast<size_t>(threads * records));
+    std::set<std::pair<int, int>> seen;
+    for (const auto& line : lines) {
+        int tid = -1, i = -1, len = -1, consumed = 0;
+        CHECK(std::sscanf(line.c_str(), "t=%d i=%d len=%d %n", &tid, &i, &len, &consumed) == 3);
+        CHECK(tid >= 0 && tid < threads && i >= 0 && i < records);
+        std::string payload = line.substr(static_cast<size_t>(consumed));
+        CHECK(payload == stress_payload(tid, i));
+        CHECK(static_cast<int>(payload.size()) == len);
+        CHECK(seen.emplace(tid, i).second);
+    }
+}
+
+} // namespace
+
+TEST(test_concurrent_log_stress) {
+    const std::string path = "stress_log.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log("t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    check_stress_lines(read_lines(path), kStressThreads, kStressRecords);
+    std::remove(path.c_str());
+}
+
+TEST(test_concurrent_log_to_stress) {
+    const std::vector<std::string> paths = {"stress_to_0.txt", "stress_to_1.txt", "stress_to_2.txt"};
+    for (const auto& p : paths) std::remove(p.c_str());
+
+    Logger logger;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &paths, t] {
+            const auto& path = paths[static_cast<size_t>(t) % paths.size()];
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_to(path, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    std::vector<std::string> all;
+    for (const auto& p : paths) {
+        auto lines = read_lines(p);
+        all.insert(all.end(), lines.begin(), lines.end());
+        std::remove(p.c_str());
+    }
+    check_stress_lines(all, kStressThreads, kStressRecords);
+}
+
+TEST(test_locked_stream_no_interleave) {
+    const std::string path = "stress_locked.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kStressRecords / 5; ++i) {
+                auto payload = stress_payload(t, i);
+                auto stream = logger.get_locked_stream(path);
+                stream << "t=" << t;
+                stream << " i=" << i;
+                stream << " len=" << payload.size() << " ";
+                stream << payload << "\n";
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    check_stress_lines(read_lines(path), kStressThreads, kStressRecords / 5);
+    std::remove(path.c_str());
+}
+
+TEST(test_record_builder_no_interleave) {
+    const std::string path = "stress_record.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                auto record = logger.begin_record(path);
+                record << "t=" << t;
+                std::this_thread::yield();
+                record << " i=" << i;
+                record << " len=" << payload.size() << " ";
+                record << payload << "\n";
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    check_stress_lines(read_lines(path), kStressThreads, kStressRecords);
+    std::remove(path.c_str());
+}
+
+TEST(test_record_builder_holds_no_lock) {
+    const std::string rec_path = "record_hold.txt";
+    const std::string other_path = "record_other.txt";
+    std::remove(rec_path.c_str());
+    std::remove(other_path.c_str());
+
+    Logger logger;
+    logger.set_log_path(rec_path);
+    {
+        auto record = logger.begin_record();
+        record << "part1 ";
+
+        // 組み立て中でも他のスレッドの書き込みはブロックされない
+        auto other = std::async(std::launch::async, [&logger, &other_path] {
+            logger.log_to(other_path, "other\n");
+        });
+        CHECK(other.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+        record << "part2" << std::endl;
+        CHECK(read_file(rec_path).empty());
+    }
+    CHECK(read_file(rec_path) == "part1 part2\n");
+    CHECK(read_file(other_path) == "other\n");
+
+    {
+        auto record = logger.begin_record(other_path);
+        record << "dropped\n";
+        record.discard();
+    }
+    {
+        auto record = logger.begin_record(other_path);
+        record << "explicit\n";
+        record.commit();
+        CHECK(read_file(other_path) == "other\nexplicit\n");
+    }
+    CHECK(read_file(other_path) == "other\nexplicit\n");
+
+    std::remove(rec_path.c_str());
+    std::remove(other_path.c_str());
+}
+
+TEST(test_set_log_path_while_logging) {
+    const std::string a = "switch_a.txt";
+    const std::string b = "switch_b.txt";
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+
+    Logger logger;
+    logger.set_log_path(a);
+    std::atomic<bool> stop{false};
+    std::thread switcher([&] {
+        bool flip = false;
+        while (!stop.load()) {
+            logger.set_log_path(flip ? a : b);
+            flip = !flip;
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&logger, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log("t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : writers) th.join();
+    stop.store(true);
+    switcher.join();
+    logger.flush();
+
+    // 各行はどちらか一方のファイルに完全な形で書き込まれる
+    auto all = read_lines(a);
+    auto lines_b = read_lines(b);
+    all.insert(all.end(), lines_b.begin(), lines_b.end());
+    check_stress_lines(all, 4, kStressRecords);
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+}
+
+TEST(test_default_handle_follows_changes) {
+    const std::string a = "default_handle_a.txt";
+    const std::string b = "default_handle_b.txt";
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+
+    // log() が覚えているハンドルは、閉じる・切り替える操作のたびに引き直される
+    Logger logger;
+    logger.set_log_path(a);
+    logger.log("1\n");
+    logger.set_log_path(b);
+    logger.log("2\n");
+    logger.close_all();
+    logger.log("3\n");
+    logger.enable_time_index(b);
+    logger.log("4\n");
+    logger.set_log_path(a);
+    logger.log("5\n");
+    logger.disable_time_index(b);
+    logger.set_log_path(b);
+    logger.log("6\n");
+    logger.reset();
+    logger.set_log_path(a);
+    logger.log("7\n");
+    logger.close_all();
+
+    CHECK(read_file(a) == "1\n5\n7\n");
+    CHECK(read_file(b) == "2\n3\n4\n6\n");
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    std::remove(logfunc_internal::time_index_path(b).c_str());
+}
+
+// ============================================================
+// FileWatcher の開始/停止の競合
+// ============================================================
+
+TEST(test_file_watcher_detects_change) {
+    const std::string path = "watch_detect.txt";
+    write_file(path, "# start\n");
+
+    logfunc_internal::FileWatcher watcher;
+    std::atomic<int> callbacks{0};
+    CHECK(watcher.start(path, [&callbacks] { callbacks.fetch_add(1); }));
+    CHECK(watcher.is_running());
+
+    // 開始直後の状態変化を取り除いてから変更する
+    watcher.wait_for_change(std::chrono::milliseconds(50));
+    auto writer = write_value_later(path, 1, std::chrono::milliseconds(20));
+    CHECK(watcher.wait_for_change(std::chrono::milliseconds(3000)));
+    writer.join();
+    CHECK(callbacks.load() > 0);
+
+    watcher.stop();
+    CHECK(!watcher.is_running());
+    std::remove(path.c_str());
+}
+
+TEST(test_file_watcher_start_stop_race) {
+    const std::string path = "watch_race.txt";
+    write_file(path, "# start\n");
+
+    std::atomic<bool> stop_writer{false};
+    std::thread writer([&] {
+        int i = 0;
+        while (!stop_writer.load()) {
+            std::ofstream file(path, std::ios::app);
+            file << i++ << "\n";
+        }
+    });
+
+    logfunc_internal::FileWatcher watcher;
+    std::atomic<int> callbacks{0};
+    for (int i = 0; i < 100; ++i) {
+        watcher.start(path, [&callbacks] { callbacks.fetch_add(1); });
+        if (i % 3 == 0) {
+            watcher.wait_for_change(std::chrono::milliseconds(1));
+        }
+        if (i % 2 == 0) {
+            watcher.stop();
+        }
+        // 奇数回は stop せずに start し直す（start 内での暗黙の停止）
+    }
+    watcher.stop();
+
+    stop_writer.store(true);
+    writer.join();
+    CHECK(!watcher.is_running());
+    std::remove(path.c_str());
+}
+
+TEST(test_file_watcher_stop_wakes_waiter) {
+    const std::string path = "watch_wake.txt";
+    write_file(path, "# start\n");
+
+    for (int i = 0; i < 20; ++i) {
+        logfunc_internal::FileWatcher watcher;
+        watcher.start(path, nullptr);
+        watcher.wait_for_change(std::chrono::milliseconds(10));
+
+        std::atomic<bool> returned{false};
+        std::thread waiter([&] {
+            watcher.wait_for_change();
+            returned.store(true);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        watcher.stop();
+        waiter.join();
+        CHECK(returned.load());
+    }
+    std::remove(path.c_str());
+}
+
+TEST(test_file_watcher_concurrent_stop) {
+    const std::string path = "watch_concurrent.txt";
+    write_file(path, "# start\n");
+
+    for (int i = 0; i < 50; ++i) {
+        logfunc_internal::FileWatcher watcher;
+        watcher.start(path, nullptr);
+        std::thread a([&] { watcher.stop(); });
+        std::thread b([&] { watcher.stop(); });
+        a.join();
+        b.join();
+        CHECK(!watcher.is_running());
+    }
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// メトリクス
+// ============================================================
+
+TEST(test_metrics_counts_records_and_paths) {
+    const std::string a = "metrics_a.txt";
+    const std::string b = "metrics_b.txt";
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+
+    Logger logger;
+    logger.set_log_path(a);
+    for (int i = 0; i < 10; ++i) {
+        logger.log("line ", i, "\n");      // "line N\n" = 7 bytes
+    }
+    logger.log_to(b, "hello\n");
+    logger.flush();
+
+    auto m = logger.get_metrics();
+    CHECK(m.records == 11);
+    CHECK(m.bytes == 10 * 7 + 6);
+    CHECK(m.file_opens == 2);
+    CHECK(m.open_files == 2);
+    CHECK(m.paths[a].records == 10);
+    CHECK(m.paths[a].bytes == 70);
+    CHECK(m.paths[b].records == 1);
+    CHECK(m.lock_wait_ns.count >= 11);
+
+    // ハンドルを閉じてもパスごとの統計は残る
+    logger.close_all();
+    logger.log("again\n");
+    m = logger.get_metrics();
+    CHECK(m.file_closes == 2);
+    CHECK(m.file_opens == 3);
+    CHECK(m.paths[a].records == 11);
+
+    auto json = m.to_json();
+    CHECK(json.front() == '{' && json.back() == '}');
+    CHECK(json.find("\"records\":12") != std::string::npos);
+    CHECK(json.find("\"metrics_a.txt\":{\"records\":11") != std::string::npos);
+    CHECK(m.to_text().find("path metrics_b.txt records=1 bytes=6") != std::string::npos);
+
+    logger.reset_metrics();
+    m = logger.get_metrics();
+    CHECK(m.records == 0);
+    CHECK(m.paths[a].records == 0);
+
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+}
+
+TEST(test_metrics_aggregates_threads) {
+    const std::string path = "metrics_threads.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger] {
+            for (int i = 0; i < 200; ++i) logger.log("x\n");
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    auto m = logger.get_metrics();
+    CHECK(m.records == static_cast<std::uint64_t>(kStressThreads * 200));
+    CHECK(m.bytes == static_cast<std::uint64_t>(kStressThreads * 200 * 2));
+    CHECK(m.lock_wait_ns.count >= m.records);
+    CHECK(m.lock_wait_ns.percentile(0.5) <= m.lock_wait_ns.max);
+    std::remove(path.c_str());
+}
+
+TEST(test_metrics_input_events) {
+    const std::string path = "metrics_in.txt";
+    write_file(path, "# waiting\n");
+
+    Logger logger;
+    logger.set_input_path(path);
+    auto writer = write_value_later(path, 3);
+    int value = 0;
+    logger.read_input(value);
+    writer.join();
+    CHECK(value == 3);
+
+    auto m = logger.get_metrics();
+    CHECK(m.watcher_events >= 1);
+    CHECK(m.input_reparses >= 2);
+    std::remove(path.c_str());
+}
+
+TEST(test_metrics_disabled) {
+    const std::string path = "metrics_off.txt";
+    Logger logger;
+    logger.set_metrics_enabled(false);
+    logger.set_log_path(path);
+    logger.log("x\n");
+
+    auto m = logger.get_metrics();
+    CHECK(m.records == 0);
+    CHECK(m.lock_wait_ns.count == 0);
+    CHECK(m.paths[path].records == 1);  // パスごとの統計はロック内で常に数える
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// ロック競合プロファイル
+// ============================================================
+
+TEST(test_lock_profile_records_sites) {
+    const std::string path = "lockprof.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+    CHECK(!logger.is_lock_profiling());
+    CHECK(logger.get_lock_profile().sites.empty());
+
+    logger.set_lock_profiling(true);
+    CHECK(logger.is_lock_profiling());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger, &path] {
+            for (int i = 0; i < 100; ++i) {
+                logger.log("log ", i, "\n");
+                logger.log_to(path, "log_to ", i, "\n");
+            }
+            logger.flush();
+            auto stream = logger.get_locked_stream(path);
+            stream << "locked\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    auto profile = logger.get_lock_profile();
+    auto find = [&profile](const std::string& name) -> const Logger::LockProfile::Site* {
+        for (const auto& site : profile.sites) {
+            if (site.name == name) return &site;
+        }
+        return nullptr;
+    };
+    CHECK(find("log") && find("log")->wait_ns.count == 400);
+    CHECK(find("log_to") && find("log_to")->hold_ns.count == 400);
+    CHECK(find("flush") && find("flush")->wait_ns.count == 4);
+    // LockedStream の保持時間は呼び出し側が保持している期間を含む
+    CHECK(find("locked_stream") && find("locked_stream")->hold_ns.max >= 2000000);
+
+    for (std::size_t i = 1; i < profile.sites.size(); ++i) {
+        CHECK(profile.sites[i - 1].wait_ns.sum >= profile.sites[i].wait_ns.sum);
+    }
+    CHECK(profile.to_text().find("locked_stream") != std::string::npos);
+    CHECK(profile.to_json().find("\"site\":\"log_to\"") != std::string::npos);
+
+    logger.set_lock_profiling(false);
+    logger.reset_lock_profile();
+    logger.log("after\n");
+    CHECK(logger.get_lock_profile().sites.empty());
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// 整形
+// ============================================================
+
+TEST(test_text_fast_path_numbers) {
+    const std::string path = "fast_numbers.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    const char* null_str = nullptr;
+    std::string s = "str";
+    logger.log_to(path, INT64_MIN, ' ', INT64_MAX, ' ', UINT64_MAX, ' ', 0, ' ', -1, ' ', 99, ' ',
+                  100u, ' ', static_cast<short>(-12), ' ', true, false, ' ', 'c', ' ', s, ' ',
+                  std::string_view("sv"), null_str, "\n");
+    logger.log_to(path, 0.1, ' ', 1e300, ' ', 123456789.0, ' ', 3.14f, ' ', -2.5, ' ', 1e-7, ' ',
+                  0.0 / 0.0, ' ', -1.0 / 0.0, "\n");
+    // operator<< の経路でも、書式を変えていない浮動小数点数は同じ表現になる
+    logger.log_to(path, std::hex, 255, ' ', 3.14159265, ' ', 3.14f, "\n");
+    logger.log_to(path, std::fixed, std::setprecision(2), 3.14159265, ' ', std::setw(6), 1.5, "\n");
+    logger.set_float_precision(6);
+    logger.log_to(path, 0.1, ' ', 123456789.0, ' ', 3.14159265f, ' ', 1e-7, "\n");
+    // マニピュレータを含む呼び出しは operator<< で整形される
+    logger.log_to(path, std::hex, 255, ' ', 3.14159265, "\n");
+    logger.flush();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 6);
+    CHECK(lines[0] == "-9223372036854775808 9223372036854775807 18446744073709551615 0 -1 99 "
+                      "100 -12 10 c str sv");
+    CHECK(lines[1] == "0.1 1e+300 123456789 3.14 -2.5 1e-07 nan -inf");
+    CHECK(lines[2] == "ff 3.14159265 3.14");
+    CHECK(lines[3] == "3.14   1.50");
+    CHECK(lines[4] == "0.1 1.23457e+08 3.14159 1e-07");
+    CHECK(lines[5] == "ff 3.14159");
+
+    // 整数は operator<< と同じ出力になる
+    std::string out;
+    std::uint64_t v = 1;
+    for (int i = 0; i < 64; ++i, v = v * 3 + 7) {
+        auto sv = static_cast<std::int64_t>(v);
+        std::ostringstream expected;
+        expected << v << ' ' << sv;
+        out.clear();
+        logfunc_internal::append_text(out, v, 0);
+        out += ' ';
+        logfunc_internal::append_text(out, sv, 0);
+        CHECK(out == expected.str());
+    }
+
+    // 最短表現は元の値に戻る
+    double d = 1.0;
+    for (int i = 0; i < 200; ++i, d = d * 1.37 + 0.001) {
+        out.clear();
+        logfunc_internal::append_text(out, d, 0);
+        CHECK(std::strtod(out.c_str(), nullptr) == d);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(test_text_compile_time_paths) {
+    using namespace logfunc_internal;
+    static_assert(is_single_char_array_v<const char (&)[15]>);
+    static_assert(!is_single_char_array_v<const char*>);
+    static_assert(fixed_text_bound_v<const char (&)[6], int&, char> == 6 + 20 + 1);
+    static_assert(fixed_text_bound_v<const char (&)[4], double> == 4 + kMaxFloatChars);
+    static_assert(fixed_text_bound_v<std::string&> == 0);
+    static_assert(fixed_text_bound_v<const char*> == 0);
+    static_assert(fixed_text_bound_v<const char (&)[2000]> == 0);  // スタック上限超え
+
+    const std::string path = "compile_time_paths.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    char partial[32] = "abc";  // 配列の途中で終端する
+    int n = -42;
+    logger.log_to(path, "input number:\n");
+    logger.log_to(path, "a", "bc", "\n");
+    logger.log_to(path, "n=", n, " x=", 2.5, " f=", 0.1f, " c=", 'z', " b=", true, "\n");
+    logger.log_to(path, partial, "|", partial, "\n");
+    logger.set_float_precision(3);
+    logger.log_to(path, "pi=", 3.14159265, "\n");
+    logger.flush();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 5);
+    CHECK(lines[0] == "input number:");
+    CHECK(lines[1] == "abc");
+    CHECK(lines[2] == "n=-42 x=2.5 f=0.1 c=z b=1");
+    CHECK(lines[3] == "abc|abc");
+    CHECK(lines[4] == "pi=3.14");
+    std::remove(path.c_str());
+
+    // 文字列リテラルの長さは N - 1（途中の '\0' も含む）。余白のある配列は '\0' までを使う
+    using logfunc_internal::char_array_view;
+    const char padded[16] = "xy";
+    char buffer[8] = "buf";
+    CHECK(char_array_view("a\0b") == std::string_view("a\0b", 3));
+    CHECK(char_array_view("") == "");
+    CHECK(char_array_view(padded) == "xy");
+    CHECK(char_array_view(buffer) == "buf");
+    std::string out;
+    logfunc_internal::append_text(out, "lit\0", 0);
+    logfunc_internal::append_text(out, padded, 0);
+    logfunc_internal::append_text(out, buffer, 0);
+    CHECK(out == "litxybuf");
+}
+
+// ============================================================
+// 構造化ログ
+// ============================================================
+
+TEST(test_structured_json) {
+    const std::string path = "structured_json.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_structured_timestamp(false);
+    std::string user = "al\"ice\n\\";
+    logger.log_kv_to(path, "login", kv("user", user), kv("attempt", 3), kv("id", 18446744073709551615ull),
+                     kv("ratio", 0.25), kv("ok", true), kv("none", nullptr), kv("bad", 0.0 / 0.0),
+                     kv("ctl", std::string_view("\x01", 1)));
+    logger.flush();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 1);
+    CHECK(lines[0] == "{\"msg\":\"login\",\"user\":\"al\\\"ice\\n\\\\\",\"attempt\":3,"
+                      "\"id\":18446744073709551615,\"ratio\":0.25,\"ok\":true,\"none\":null,"
+                      "\"bad\":null,\"ctl\":\"\\u0001\"}");
+
+    logger.set_structured_timestamp(true);
+    logger.log_kv_to(path, "tick");
+    logger.flush();
+    lines = read_lines(path);
+    CHECK(lines.size() == 2);
+    CHECK(lines[1].rfind("{\"ts\":", 0) == 0);
+    CHECK(lines[1].find(",\"msg\":\"tick\"}") != std::string::npos);
+    std::remove(path.c_str());
+}
+
+TEST(test_structured_logfmt_and_text) {
+    const std::string path = "structured_logfmt.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+    logger.set_structured_timestamp(false);
+    logger.set_structured_format(Logger::StructuredFormat::Logfmt);
+    logger.log_kv("user login", kv("user", "bob"), kv("note", "a=b c"), kv("empty", ""),
+                  kv("bad key", -7), kv("grade", 'A'));
+    logger.set_structured_format(Logger::StructuredFormat::Text);
+    logger.log_kv("plain text", kv("k", "v"), kv("x", 1.5));
+    logger.flush();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 2);
+    CHECK(lines[0] == "msg=\"user login\" user=bob note=\"a=b c\" empty=\"\" bad_key=-7 grade=A");
+    CHECK(lines[1] == "plain text k=v x=1.5");
+    std::remove(path.c_str());
+}
+
+TEST(test_json_escape_kernels) {
+    using namespace logfunc_internal;
+    std::vector<FindJsonEscapeFn> kernels = {&find_json_escape, json_escape_kernel()};
+#if LOGFUNC_SIMD_X86
+    kernels.push_back(&find_json_escape_sse2);
+    if (cpu_has_avx2()) {
+        kernels.push_back(&find_json_escape_avx2);
+    }
+#endif
+    // UTF-8 の上位バイトや DEL はエスケープ対象ではない
+    const std::string clean_bytes = "abc XYZ 019 \x7f\xc3\xa9\xe3\x81\x82\xff/{}:,";
+    const char dirty[] = {'"', '\\', '\n', '\0', '\x1f', '\x01'};
+
+    for (std::size_t len = 0; len <= 100; ++len) {
+        std::string s;
+        for (std::size_t i = 0; i < len; ++i) s += clean_bytes[i % clean_bytes.size()];
+        for (auto fn : kernels) {
+            CHECK(fn(s.data(), s.data() + s.size()) == s.data() + s.size());
+        }
+        for (std::size_t pos = 0; pos < len; ++pos) {
+            std::string d = s;
+            d[pos] = dirty[pos % sizeof(dirty)];
+            for (auto fn : kernels) {
+                CHECK(fn(d.data(), d.data() + d.size()) == d.data() + pos);
+            }
+        }
+    }
+
+    std::string out;
+    append_json_escaped(out, "0123456789abcdef0123456789abcdef\"x\\y\n\x02\xc3\xa9");
+    CHECK(out == "0123456789abcdef0123456789abcdef\\\"x\\\\y\\n\\u0002\xc3\xa9");
+}
+
+TEST(test_structured_concurrent) {
+    const std::string path = "structured_stress.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_kv("stress", kv("t", t), kv("i", i), kv("payload", payload));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == static_cast<size_t>(kStressThreads * kStressRecords));
+    for (const auto& line : lines) {
+        CHECK(line.front() == '{' && line.back() == '}');
+        CHECK(line.find("\"msg\":\"stress\"") != std::string::npos);
+    }
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// サンプリング・重複抑制
+// ============================================================
+
+TEST(test_every_n_sampling) {
+    const std::string path = "sampling_every_n.txt";
+    std::remove(path.c_str());
+    log_reset_metrics();
+
+    int evaluated = 0;
+    auto expensive = [&evaluated](int i) { ++evaluated; return i; };
+    for (int i = 0; i < 100; ++i) {
+        LOGTO_EVERY_N(10, path, "i=", expensive(i), "\n");
+    }
+    log_flush(path);
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 10);
+    CHECK(lines[0] == "i=0");
+    CHECK(lines[9] == "i=90");
+    // 捨てた呼び出しでは引数を評価しない
+    CHECK(evaluated == 10);
+    CHECK(log_get_metrics().sampled_out == 90);
+
+    // 呼び出し箇所ごとに独立して数える
+    int a = 0, b = 0;
+    for (int i = 0; i < 6; ++i) {
+        if (LOGFUNC_EVERY_N(3)) ++a;
+        if (LOGFUNC_EVERY_N(2)) ++b;
+    }
+    CHECK(a == 2);
+    CHECK(b == 3);
+    log_close_all();
+    std::remove(path.c_str());
+}
+
+TEST(test_rate_limited) {
+    const std::string path = "sampling_rate.txt";
+    std::remove(path.c_str());
+
+    // 1回/秒・バースト 5: 短時間の連続呼び出しはバースト分だけ通る
+    for (int i = 0; i < 1000; ++i) {
+        LOGTO_RATE_LIMITED(1.0, 5, path, "i=", i, "\n");
+    }
+    log_flush(path);
+    auto lines = read_lines(path);
+    CHECK(lines.size() >= 5 && lines.size() <= 6);
+    CHECK(lines[0] == "i=0");
+
+    // トークンは時間とともに補充される
+    logfunc_internal::RateLimiter limiter;
+    CHECK(limiter.allow(50.0, 1));
+    CHECK(!limiter.allow(50.0, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(limiter.allow(50.0, 1));
+    CHECK(!limiter.allow(0.0, 1));
+    log_close_all();
+    std::remove(path.c_str());
+}
+
+TEST(test_dedup_repeats) {
+    const std::string path = "dedup.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.set_log_path(path);
+    logger.set_dedup_repeats(true);
+    for (int i = 0; i < 5; ++i) logger.log("same\n");
+    logger.log("other\n");
+    logger.log("other\n");
+    logger.log_to("dedup_other.txt", "same\n");  // ファイルごとに比較する
+    logger.flush();
+    logger.log("other\n");
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 4);
+    CHECK(lines[0] == "same");
+    CHECK(lines[1] == "last message repeated 4 times");
+    CHECK(lines[2] == "other");
+    CHECK(lines[3] == "last message repeated 1 times");
+
+    // 無効化すると保留中の回数を書き出す
+    logger.set_dedup_repeats(false);
+    logger.log("other\n");
+    logger.flush();
+    lines = read_lines(path);
+    CHECK(lines.size() == 6);
+    CHECK(lines[4] == "last message repeated 1 times");
+    CHECK(lines[5] == "other");
+    CHECK(logger.get_metrics().deduplicated == 6);
+
+    logger.close_all();
+    std::remove(path.c_str());
+    std::remove("dedup_other.txt");
+}
+
+// ============================================================
+// フライトレコーダー
+// ============================================================
+
+TEST(test_flight_recorder_ring) {
+    const std::string log_path = "flight_log.txt";
+    const std::string dump_path = "flight_dump.txt";
+    std::remove(log_path.c_str());
+    std::remove(dump_path.c_str());
+
+    Logger logger;
+    logger.set_log_path(log_path);
+    Logger::FlightRecorderOptions options;
+    options.capacity = 4;
+    logger.enable_flight_recorder(options);
+    CHECK(logger.is_flight_recorder_enabled());
+
+    for (int i = 0; i < 10; ++i) {
+        logger.log("record ", i, "\n");
+    }
+    logger.log_kv_to("other.txt", "kv");
+    logger.flush();
+    // リングに入るだけでファイルには書かれない
+    CHECK(read_file(log_path).empty());
+    CHECK(!std::filesystem::exists("other.txt"));
+
+    CHECK(logger.dump_flight_recorder(dump_path, 2) == 2);
+    logger.flush();
+    auto lines = read_lines(dump_path);
+    CHECK(lines.size() == 2);
+    CHECK(lines[0] == "record 9");
+    CHECK(lines[1].find("\"msg\":\"kv\"") != std::string::npos);
+    // 件数で絞ったときの古いレコードはリングに残り、ダンプしたレコードだけが消える
+    CHECK(logger.dump_flight_recorder(dump_path) == 2);
+    logger.flush();
+    lines = read_lines(dump_path);
+    CHECK(lines.size() == 4);
+    CHECK(lines[2] == "record 7");
+    CHECK(lines[3] == "record 8");
+    CHECK(logger.dump_flight_recorder(dump_path) == 0);
+
+    logger.disable_flight_recorder();
+    logger.log("direct\n");
+    logger.flush();
+    CHECK(read_lines(log_path) == std::vector<std::string>{"direct"});
+    CHECK(logger.dump_flight_recorder(dump_path) == 0);
+
+    logger.close_all();
+    std::remove(log_path.c_str());
+    std::remove(dump_path.c_str());
+}
+
+TEST(test_flight_recorder_dump_to_origin) {
+    const std::string log_path = "flight_origin_default.txt";
+    const std::string a_path = "flight_origin_a.txt";
+    const std::string b_path = "flight_origin_b.txt";
+    for (const auto& p : {log_path, a_path, b_path}) std::remove(p.c_str());
+
+    Logger logger;
+    logger.set_log_path(log_path);
+    logger.enable_flight_recorder();
+
+    logger.log("default 1\n");
+    logger.log_to(a_path, "a 1\n");
+    logger.log_to(b_path, "b 1\n");
+    logger.log_to(a_path, "a 2\n");
+    logger.log("default 2\n");
+    logger.flush();
+    CHECK(!std::filesystem::exists(a_path));
+
+    // 出力先を指定しなければ、各レコードは記録時の出力先へ古い順に戻る
+    CHECK(logger.dump_flight_recorder() == 5);
+    logger.flush();
+    CHECK((read_lines(log_path) == std::vector<std::string>{"default 1", "default 2"}));
+    CHECK((read_lines(a_path) == std::vector<std::string>{"a 1", "a 2"}));
+    CHECK((read_lines(b_path) == std::vector<std::string>{"b 1"}));
+
+    logger.close_all();
+    for (const auto& p : {log_path, a_path, b_path}) std::remove(p.c_str());
+}
+
+TEST(test_flight_recorder_trigger) {
+    const std::string dump_path = "flight_trigger.txt";
+    std::remove(dump_path.c_str());
+
+    Logger logger;
+    Logger::FlightRecorderOptions options;
+    options.capacity = 100;
+    options.trigger = "FATAL";
+    options.dump_path = dump_path;
+    logger.enable_flight_recorder(options);
+
+    logger.log("step 1\n");
+    logger.log("step 2\n");
+    CHECK(!std::filesystem::exists(dump_path));
+    logger.log("FATAL: disk full\n");
+    logger.log("after\n");
+    logger.flush();
+
+    auto lines = read_lines(dump_path);
+    CHECK(lines.size() == 3);
+    CHECK(lines[0] == "step 1");
+    CHECK(lines[2] == "FATAL: disk full");
+    logger.close_all();
+    std::remove(dump_path.c_str());
+}
+
+TEST(test_flight_recorder_concurrent_dump) {
+    const std::string dump_path = "flight_concurrent.txt";
+    std::remove(dump_path.c_str());
+
+    Logger logger;
+    Logger::FlightRecorderOptions options;
+    options.capacity = static_cast<std::size_t>(kStressThreads * kStressRecords);
+    logger.enable_flight_recorder(options);
+
+    std::atomic<bool> done{false};
+    std::thread dumper([&] {
+        while (!done.load()) {
+            logger.dump_flight_recorder(dump_path);
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log("t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    done = true;
+    dumper.join();
+    logger.dump_flight_recorder(dump_path);
+    logger.flush();
+
+    // 途中のダンプと最後のダンプを合わせて全レコードが1回ずつ現れる
+    check_stress_lines(read_lines(dump_path), kStressThreads, kStressRecords);
+    logger.close_all();
+    std::remove(dump_path.c_str());
+}
+
+// ============================================================
+// 出力先（シンク）
+// ============================================================
+
+namespace {
+
+// 受け取ったデータと呼び出し回数を外部に記録するシンク
+struct MemorySinkState {
+    std::string data;
+    int flushes = 0;
+    int destroyed = 0;
+};
+
+class MemorySink : public Logger::Sink {
+public:
+    explicit MemorySink(MemorySinkState& state) : state_(state) {}
+    ~MemorySink() override { state_.destroyed += 1; }
+    void write(std::string_view data) override { state_.data.append(data.data(), data.size()); }
+    void flush() override { state_.flushes += 1; }
+
+private:
+    MemorySinkState& state_;
+};
+
+} // namespace
+
+TEST(test_sink_routes_path) {
+    const std::string path = "sink_test.txt";
+    const std::string other = "sink_other.txt";
+    std::remove(path.c_str());
+    std::remove(other.c_str());
+
+    Logger logger;
+    MemorySinkState state;
+    std::vector<std::string> opened;
+    logger.set_sink(path, [&](const std::string& p) -> std::unique_ptr<Logger::Sink> {
+        opened.push_back(p);
+        return std::make_unique<MemorySink>(state);
+    });
+
+    logger.log_to(path, "first ", 1, "\n");
+    {
+        auto stream = logger.get_locked_stream(path);
+        stream << "locked " << 2 << "\n";
+    }
+    logger.log_to(other, "plain\n");
+    logger.flush();
+
+    CHECK(opened.size() == 1 && opened[0] == path);
+    CHECK(state.data == "first 1\nlocked 2\n");
+    CHECK(state.flushes >= 1);
+    CHECK(!std::ifstream(path).good());
+    CHECK(read_file(other) == "plain\n");
+
+    // close_all でシンクを破棄し、次の書き込みで作り直す
+    logger.close_all();
+    CHECK(state.destroyed == 1);
+    logger.log_to(path, "again\n");
+    CHECK(opened.size() == 2);
+    CHECK(state.data == "first 1\nlocked 2\nagain\n");
+
+    // 空の factory で通常のファイル出力に戻す
+    logger.set_sink(path, nullptr);
+    CHECK(state.destroyed == 2);
+    logger.log_to(path, "file\n");
+    logger.close_all();
+    CHECK(read_file(path) == "file\n");
+
+    std::remove(path.c_str());
+    std::remove(other.c_str());
+}
+
+TEST(test_get_or_open_with_sink) {
+    const std::string path = "sink_stream.txt";
+    const std::string shared = "sink_stream_shared.txt";
+    std::remove(shared.c_str());
+
+    // シンクを登録したパスでも get_or_open への書き込みはシンクに届く
+    Logger logger;
+    MemorySinkState state;
+    logger.set_sink(path, [&](const std::string&) -> std::unique_ptr<Logger::Sink> {
+        return std::make_unique<MemorySink>(state);
+    });
+    logger.get_or_open(path) << "direct " << 1 << "\n";
+    logger.log_to(path, "next\n");
+    logger.get_or_open(path) << "last\n";
+    logger.close_all();
+    CHECK(state.data == "direct 1\nnext\nlast\n");
+
+    Logger appender;
+    appender.enable_shared_append();
+    appender.get_or_open(shared) << "hello\n";
+    appender.close_all();
+    CHECK(read_file(shared) == "hello\n");
+    std::remove(shared.c_str());
+}
+
+TEST(test_sink_factory_failure) {
+    const std::string path = "sink_fail.txt";
+    Logger logger;
+    logger.set_sink(path, [](const std::string&) -> std::unique_ptr<Logger::Sink> {
+        throw std::runtime_error("sink unavailable");
+    });
+
+    // サイレントモード（デフォルト）では書き込みを捨てて続行する
+    logger.log_to(path, "x\n");
+    CHECK(!std::ifstream(path).good());
+
+    logger.set_silent_mode(false);
+    bool threw = false;
+    try {
+        logger.log_to(path, "x\n");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+// ============================================================
+// 時刻インデックス
+// ============================================================
+
+TEST(test_time_index_range) {
+    const std::string path = "indexed_log.txt";
+    const std::string index_path = path + ".idx";
+    std::remove(path.c_str());
+    std::remove(index_path.c_str());
+
+    Logger logger;
+    Logger::TimeIndexOptions options;
+    options.every_records = 10;
+    options.every_bytes = 0;
+    logger.enable_time_index(path, options);
+
+    auto write_block = [&](const char* tag) {
+        for (int i = 0; i < 30; ++i) {
+            logger.log_to(path, tag, " ", i, "\n");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    };
+    write_block("a");
+    auto from = std::chrono::system_clock::now();
+    write_block("b");
+    auto to = std::chrono::system_clock::now();
+    // ミリ秒単位で to と同じ時刻に c を書かないようにする
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    write_block("c");
+    logger.flush();
+
+    // エントリは 10 件ごとで、どれもレコードの先頭を指す
+    std::string content = read_file(path);
+    auto index = Logger::TimeIndex::load(path);
+    CHECK(index.entries().size() == 9);
+    for (std::size_t i = 0; i < index.entries().size(); ++i) {
+        const auto& entry = index.entries()[i];
+        CHECK(entry.offset < content.size());
+        CHECK(entry.offset == 0 || content[entry.offset - 1] == '\n');
+        if (i > 0) {
+            CHECK(entry.offset > index.entries()[i - 1].offset);
+            CHECK(entry.time_ms >= index.entries()[i - 1].time_ms);
+        }
+    }
+
+    // b の全レコードと、直前のエントリから b までの a のレコードだけを返す
+    std::string expected;
+    for (int i = 20; i < 30; ++i) expected += "a " + std::to_string(i) + "\n";
+    for (int i = 0; i < 30; ++i) expected += "b " + std::to_string(i) + "\n";
+    CHECK(log_read_time_range(path, from, to) == expected);
+
+    // 範囲が末尾を含むときはファイルの最後まで
+    std::string tail = log_read_time_range(path, to, std::chrono::system_clock::now());
+    CHECK(tail.size() >= 30 && tail.compare(tail.size() - 5, 5, "c 29\n") == 0);
+
+    // 開き直した後のエントリも既存の内容の後ろを指す
+    logger.close_all();
+    logger.log_to(path, "reopened\n");
+    logger.flush();
+    index = Logger::TimeIndex::load(path);
+    CHECK(index.entries().size() == 10);
+    CHECK(index.entries().back().offset == content.size());
+
+    logger.disable_time_index(path);
+    logger.log_to(path, "unindexed\n");
+    logger.close_all();
+    CHECK(Logger::TimeIndex::load(path).entries().size() == 10);
+
+    std::remove(path.c_str());
+    std::remove(index_path.c_str());
+}
+
+TEST(test_time_index_every_bytes) {
+    const std::string path = "indexed_bytes.txt";
+    const std::string index_path = path + ".idx";
+    std::remove(path.c_str());
+    std::remove(index_path.c_str());
+
+    Logger logger;
+    Logger::TimeIndexOptions options;
+    options.every_records = 0;
+    options.every_bytes = 1000;
+    logger.enable_time_index(path, options);
+
+    // 100 バイトのレコード 100 件 → 10 レコードごとにエントリ
+    std::string record(99, 'x');
+    for (int i = 0; i < 100; ++i) {
+        logger.log_to(path, record, "\n");
+    }
+    logger.close_all();
+
+    auto index = Logger::TimeIndex::load(path);
+    CHECK(index.entries().size() == 10);
+    for (std::size_t i = 0; i < index.entries().size(); ++i) {
+        CHECK(index.entries()[i].offset == i * 1000);
+    }
+    std::remove(path.c_str());
+    std::remove(index_path.c_str());
+}
+
+TEST(test_time_index_skips_sink_paths) {
+    const std::string path = "indexed_shared.txt";
+    const std::string index_path = path + ".idx";
+    std::remove(path.c_str());
+    std::remove(index_path.c_str());
+
+    // 共有追記はシンク経由なのでインデックスは書かず、ログ本体だけが書かれる
+    Logger logger;
+    logger.enable_shared_append();
+    logger.enable_time_index(path);
+    logger.log_to(path, "record\n");
+    logger.close_all();
+
+    CHECK(read_file(path) == "record\n");
+    CHECK(!std::filesystem::exists(index_path));
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// ログリーダー
+// ============================================================
+
+TEST(test_reader_filters) {
+    const std::string path = "reader_test.txt";
+    write_file(path,
+               "INFO start\n"
+               "ERROR disk full\n"
+               "ERRORS are not a level\n"
+               "[ERROR] timeout on request 7\n"
+               "INFO timeout retried\n"
+               "level=ERROR msg=\"timeout\"\n"
+               "no newline at end ERROR");
+
+    LogReader reader(path);
+    LogQuery query;
+    CHECK(reader.count(query) == 7);
+
+    query.level = "ERROR";
+    auto records = reader.query(query);
+    CHECK(records.size() == 4);
+    CHECK(records[0] == "ERROR disk full");
+    CHECK(records[1] == "[ERROR] timeout on request 7");
+    CHECK(records[3] == "no newline at end ERROR");
+
+    query.contains = "timeout";
+    records = reader.query(query);
+    CHECK(records.size() == 2);
+    CHECK(records[1] == "level=ERROR msg=\"timeout\"");
+
+    query.level.clear();
+    query.predicate = [](std::string_view r) { return r.front() == 'I'; };
+    records = reader.query(query);
+    CHECK(records.size() == 1 && records[0] == "INFO timeout retried");
+
+    std::remove(path.c_str());
+}
+
+TEST(test_reader_parallel_matches_sequential) {
+    const std::string path = "reader_parallel.txt";
+    std::remove(path.c_str());
+    {
+        Logger logger;
+        std::string payload(40, 'p');
+        for (int i = 0; i < 60000; ++i) {
+            logger.log_to(path, i % 7 == 0 ? "WARN" : "INFO", " record ", i, " ", payload, "\n");
+        }
+    }
+
+    LogReader reader(path);
+    LogQuery query;
+    query.level = "WARN";
+    query.threads = 1;
+    auto sequential = reader.query(query);
+    query.threads = 8;
+    auto parallel = reader.query(query);
+    CHECK(sequential.size() == (60000 + 6) / 7);
+    CHECK(parallel == sequential);
+    CHECK(reader.count(query) == sequential.size());
+
+    // 部分文字列の高速経路も同じ結果になる
+    query.level.clear();
+    query.contains = "record 5999";
+    auto hits = reader.query(query);
+    CHECK(hits.size() == 11);  // 5999 と 59990..59999
+    CHECK(hits.front().find("record 5999 ") != std::string_view::npos);
+
+    std::remove(path.c_str());
+}
+
+TEST(test_reader_time_range) {
+    const std::string path = "reader_time.txt";
+    write_file(path,
+               "1000000000000 text before\n"
+               "ts=1000000001000 msg=logfmt inside\n"
+               "{\"ts\":1000000002000,\"msg\":\"json inside\"}\n"
+               "untimed line\n"
+               "42 short number is not a timestamp\n"
+               "1000000003000 text after\n");
+
+    LogReader reader(path);
+    LogQuery query;
+    query.from_ms = 1000000000500;
+    query.to_ms = 1000000002000;
+    auto records = reader.query(query);
+    CHECK(records.size() == 2);
+    CHECK(records[0] == "ts=1000000001000 msg=logfmt inside");
+    CHECK(records[1] == "{\"ts\":1000000002000,\"msg\":\"json inside\"}");
+    std::remove(path.c_str());
+
+    // 時刻インデックスがあれば、その範囲内のタイムスタンプのないレコードも返す
+    const std::string indexed = "reader_indexed.txt";
+    std::remove(indexed.c_str());
+    std::remove((indexed + ".idx").c_str());
+    Logger logger;
+    Logger::TimeIndexOptions options;
+    options.every_records = 5;
+    logger.enable_time_index(indexed, options);
+    for (int i = 0; i < 20; ++i) logger.log_to(indexed, "early ", i, "\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto now_ms = [] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    };
+    LogQuery late;
+    late.from_ms = now_ms();
+    for (int i = 0; i < 20; ++i) logger.log_to(indexed, "late ", i, "\n");
+    logger.close_all();
+
+    LogReader indexed_reader(indexed);
+    records = indexed_reader.query(late);
+    CHECK(records.size() == 25);  // 直前のエントリ以降の early 5件 + late 20件
+    CHECK(records.front() == "early 15");
+    CHECK(records.back() == "late 19");
+    std::remove(indexed.c_str());
+    std::remove((indexed + ".idx").c_str());
+}
+
+TEST(test_reader_empty_and_missing) {
+    const std::string path = "reader_empty.txt";
+    write_file(path, "");
+    LogReader reader(path);
+    CHECK(reader.data().empty());
+    CHECK(reader.query(LogQuery{}).empty());
+    std::remove(path.c_str());
+
+    bool threw = false;
+    try {
+        LogReader missing("reader_missing_file.txt");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+// ============================================================
+// 複数プロセスからの追記
+// ============================================================
+
+TEST(test_shared_append_threads) {
+    const std::string path = "shared_append.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    Logger::SharedAppendOptions options;
+    options.atomic_write_max = 100;  // 長いレコードはロック経由
+    logger.enable_shared_append(options);
+    CHECK(logger.is_shared_append());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                if (i % 50 == 0) {
+                    auto stream = logger.get_locked_stream(path);
+                    stream << "t=" << t << " i=" << i;
+                    stream << " len=" << payload.size() << " " << payload << "\n";
+                } else {
+                    logger.log_to(path, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.close_all();
+
+    check_stress_lines(read_lines(path), kStressThreads, kStressRecords);
+    logger.disable_shared_append();
+    CHECK(!logger.is_shared_append());
+    std::remove(path.c_str());
+}
+
+#ifndef _WIN32
+TEST(test_shared_append_processes) {
+    const std::string path = "shared_append_procs.txt";
+    std::remove(path.c_str());
+    constexpr int kProcesses = 4;
+
+    std::vector<pid_t> children;
+    for (int p = 0; p < kProcesses; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // 子プロセスはそれぞれ自分の Logger で同じファイルに書く
+            Logger logger;
+            Logger::SharedAppendOptions options;
+            options.atomic_write_max = 100;
+            logger.enable_shared_append(options);
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(p, i);
+                logger.log_to(path, "t=", p, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+            logger.close_all();
+            std::_Exit(0);
+        }
+        CHECK(pid > 0);
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        CHECK(waitpid(pid, &status, 0) == pid);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    check_stress_lines(read_lines(path), kProcesses, kStressRecords);
+    std::remove(path.c_str());
+}
+#endif
+
+// ============================================================
+// ページキャッシュを通さない出力
+// ============================================================
+
+#ifndef _WIN32
+TEST(test_direct_io_threads) {
+    const std::string path = "direct_io.txt";
+    write_file(path, "existing line\n");  // 端数ブロックから続きを書く
+
+    Logger logger;
+    Logger::DirectIOOptions options;
+    options.buffer_bytes = 8192;   // 何度もバッファを入れ替える
+    options.buffer_count = 2;
+    options.preallocate_bytes = 64 * 1024;
+    logger.enable_direct_io(options);
+    CHECK(logger.is_direct_io());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_to(path, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.close_all();
+
+    auto content = read_file(path);
+    CHECK(content.find('\0') == std::string::npos);
+    auto lines = read_lines(path);
+    CHECK(!lines.empty() && lines.front() == "existing line");
+    lines.erase(lines.begin());
+    check_stress_lines(lines, kStressThreads, kStressRecords);
+
+    logger.disable_direct_io();
+    CHECK(!logger.is_direct_io());
+    std::remove(path.c_str());
+}
+
+TEST(test_direct_io_flush_tail) {
+    const std::string path = "direct_io_tail.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.enable_direct_io();
+    std::string expected;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            std::string line = "round " + std::to_string(round) + " record " + std::to_string(i) + "\n";
+            logger.log_to(path, line);
+            expected += line;
+        }
+        // flush のたびに端数ブロックを書き、ファイルサイズは書いた分だけになる
+        logger.flush(path);
+        CHECK(read_file(path) == expected);
+        CHECK(std::filesystem::file_size(path) == expected.size());
+    }
+    logger.close_all();
+    CHECK(read_file(path) == expected);
+    std::remove(path.c_str());
+}
+#endif
+
+// ============================================================
+// 永続性
+// ============================================================
+
+TEST(test_durability_group_sync) {
+    const std::string path = "durability_sync.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    Logger::DurabilityPolicy policy;
+    policy.level = Logger::Durability::GroupSync;
+    policy.window = std::chrono::microseconds(500);
+    logger.set_durability(path, policy);
+    CHECK(logger.get_durability(path).level == Logger::Durability::GroupSync);
+
+    // 開く前のパスのチケットは完了済み
+    CHECK(logger.commit_ticket(path).done());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, &path, t] {
+            for (int i = 0; i < 50; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_to(path, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+                auto ticket = logger.commit_ticket(path);
+                ticket.wait();
+                CHECK(ticket.done());
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    // 待たずに閉じても、残りは同期してからチケットが完了する
+    logger.log_to(path, "t=0 i=50 len=", stress_payload(0, 50).size(), " ", stress_payload(0, 50), "\n");
+    auto last = logger.commit_ticket(path);
+    logger.close_all();
+    CHECK(last.done());
+    CHECK(last.wait_for(std::chrono::milliseconds(0)));
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == kStressThreads * 50 + 1);
+    lines.pop_back();
+    check_stress_lines(lines, kStressThreads, 50);
+    std::remove(path.c_str());
+}
+
+TEST(test_durability_group_sync_direct_io) {
+    const std::string path = "durability_direct.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    logger.enable_direct_io();
+    Logger::DurabilityPolicy policy;
+    policy.level = Logger::Durability::GroupSync;
+    logger.set_durability(path, policy);
+
+    // チケットが完了した時点で、レコードはシンクのバッファではなくファイルにある
+    std::string expected;
+    for (int i = 0; i < 20; ++i) {
+        logger.log_to(path, "record ", i, "\n");
+        expected += "record " + std::to_string(i) + "\n";
+        auto ticket = logger.commit_ticket(path);
+        CHECK(ticket.wait());
+        CHECK(ticket.done() && !ticket.failed());
+        CHECK(read_file(path) == expected);
+    }
+
+    // LockedStream の内容もチケットの対象になる
+    logger.get_locked_stream(path) << "locked\n";
+    CHECK(logger.commit_ticket(path).wait());
+    CHECK(read_file(path) == expected + "locked\n");
+    logger.close_all();
+    std::remove(path.c_str());
+}
+
+TEST(test_group_committer_batches_syncs) {
+    const std::string path = "durability_batch.txt";
+    write_file(path, "x\n");
+    {
+        logfunc_internal::GroupCommitter committer(path, std::chrono::milliseconds(20));
+        std::uint64_t seq = 0;
+        for (int i = 0; i < 1000; ++i) {
+            seq = committer.note_write();
+        }
+        CHECK(committer.wait(seq, std::chrono::seconds(5)));
+        CHECK(committer.sync_count() >= 1 && committer.sync_count() <= 2);
+        CHECK(committer.is_synced(seq));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(test_durability_none_and_flush) {
+    const std::string path = "durability_none.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    Logger::DurabilityPolicy policy;
+    policy.level = Logger::Durability::None;
+    logger.set_durability(path, policy);
+    logger.log_to(path, "buffered\n");
+    CHECK(read_file(path).empty());   // stdio のバッファに残っている
+    logger.flush(path);
+    CHECK(read_file(path) == "buffered\n");
+    CHECK(logger.commit_ticket(path).done());
+
+    // Flush（デフォルト）に戻すとレコードごとに書く
+    logger.set_durability(path, {});
+    logger.log_to(path, "direct\n");
+    CHECK(read_file(path) == "buffered\ndirect\n");
+    logger.close_all();
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// 共有バックエンド
+// ============================================================
+
+TEST(test_shared_backend_dedups_files) {
+    const std::string path = "backend_shared.txt";
+    std::remove(path.c_str());
+
+    auto backend = std::make_shared<Logger::SharedBackend>();
+    Logger first;
+    Logger second;
+    first.attach_backend(backend);
+    second.attach_backend(backend);
+    CHECK(first.has_backend());
+
+    // 別々の Logger が別のパス表記で同じファイルに書く
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&, t] {
+            Logger& logger = t % 2 == 0 ? first : second;
+            const std::string target = t % 2 == 0 ? path : "./" + path;
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_to(target, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    CHECK(backend->file_count() == 1);
+    CHECK(backend->write_calls() < static_cast<std::uint64_t>(kStressThreads * kStressRecords));
+
+    first.close_all();
+    second.close_all();
+    CHECK(backend->file_count() == 0);
+    check_stress_lines(read_lines(path), kStressThreads, kStressRecords);
+
+    second.detach_backend();
+    CHECK(!second.has_backend());
+    std::remove(path.c_str());
+}
+
+TEST(test_shared_backend_flush) {
+    const std::string path = "backend_flush.txt";
+    std::remove(path.c_str());
+
+    Logger::SharedBackendOptions options;
+    options.max_pending_bytes = 64;  // 書き込みスレッドを待つ経路も通る
+    auto backend = std::make_shared<Logger::SharedBackend>(options);
+    Logger logger;
+    logger.attach_backend(backend);
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+        std::string line = "record " + std::to_string(i) + "\n";
+        logger.log_to(path, line);
+        expected += line;
+    }
+    logger.flush(path);
+    CHECK(read_file(path) == expected);
+
+    // 切り離すと自分でファイルを開く
+    logger.detach_backend();
+    logger.log_to(path, "after\n");
+    CHECK(read_file(path) == expected + "after\n");
+    logger.close_all();
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// 名前付きロガー
+// ============================================================
+
+TEST(test_named_logger_inherits_levels) {
+    NamedLogger& http = get_logger("t_inherit.net.http");
+    NamedLogger& net = get_logger("t_inherit.net");
+    CHECK(http.parent() == &net);
+    CHECK(&get_logger("t_inherit.net.http") == &http);
+    CHECK(http.level() == LogLevel::Info);   // ルートの既定値
+
+    net.set_level(LogLevel::Debug);
+    CHECK(http.enabled(LogLevel::Debug));
+    CHECK(!http.enabled(LogLevel::Trace));
+
+    // 自分で設定したレベルは親の変更で上書きされない
+    http.set_level(LogLevel::Error);
+    net.set_level(LogLevel::Trace);
+    CHECK(http.level() == LogLevel::Error);
+    CHECK(get_logger("t_inherit.net.dns").level() == LogLevel::Trace);
+
+    http.clear_level();
+    CHECK(http.level() == LogLevel::Trace);
+    log_set_level("t_inherit", LogLevel::Off);
+    CHECK(http.level() == LogLevel::Trace);   // net が自分で設定している
+    net.clear_level();
+    CHECK(!http.enabled(LogLevel::Fatal));
+
+    LogLevel parsed = LogLevel::Info;
+    CHECK(parse_log_level("warn", parsed) && parsed == LogLevel::Warn);
+    CHECK(!parse_log_level("verbose", parsed));
+}
+
+TEST(test_named_logger_targets) {
+    const std::string db_path = "named_db.txt";
+    const std::string all_path = "named_all.txt";
+    std::remove(db_path.c_str());
+    std::remove(all_path.c_str());
+
+    Logger logger;
+    NamedLogger& app = get_logger("t_target");
+    NamedLogger& pool = get_logger("t_target.db.pool");
+    app.set_target(all_path, &logger);
+    log_set_target("t_target.db", db_path, &logger);
+
+    int evaluated = 0;
+    auto count = [&evaluated] { return ++evaluated; };
+    LOGN(pool, Info, "connections=", count(), "\n");
+    LOGN(pool, Debug, "never ", count(), "\n");   // 無効なレベルの引数は評価しない
+    app.warn("disk ", 91, "%\n");
+    CHECK(evaluated == 1);
+
+    log_clear_target("t_target.db");
+    pool.error("timeout\n");
+    logger.close_all();
+
+    CHECK(read_file(db_path) == "[INFO] t_target.db.pool: connections=1\n");
+    CHECK(read_file(all_path) == "[WARN] t_target: disk 91%\n[ERROR] t_target.db.pool: timeout\n");
+    app.clear_target();
+    std::remove(db_path.c_str());
+    std::remove(all_path.c_str());
+}
+
+TEST(test_named_logger_level_changes_while_logging) {
+    const std::string path = "named_threads.txt";
+    std::remove(path.c_str());
+
+    Logger logger;
+    NamedLogger& worker = get_logger("t_threads.worker");
+    get_logger("t_threads").set_target(path, &logger);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&worker, &stop, t] {
+            for (int i = 0; !stop.load(); ++i) {
+                LOGN(worker, Debug, "t=", t, " i=", i, "\n");
+            }
+        });
+    }
+    for (int i = 0; i < 200; ++i) {
+        log_set_level("t_threads", i % 2 == 0 ? LogLevel::Debug : LogLevel::Warn);
+    }
+    stop = true;
+    for (auto& th : threads) th.join();
+    logger.close_all();
+
+    for (const auto& line : read_lines(path)) {
+        CHECK(line.rfind("[DEBUG] t_threads.worker: t=", 0) == 0);
+    }
+    std::remove(path.c_str());
+}
+
+// ============================================================
+// 制御ファイル
+// ============================================================
+
+namespace {
+
+// 監視スレッドが n 版目を反映するまで待つ
+bool wait_applied(const LogControl& control, std::uint64_t n) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (control.applied_count() < n && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return control.applied_count() >= n;
+}
+
+} // namespace
+
+TEST(test_control_file_levels_and_targets) {
+    const std::string ctl = "control_levels.ctl";
+    const std::string path = "control_levels.txt";
+    std::remove(path.c_str());
+    write_file(ctl, "# incident\nlevel t_ctl.net debug\nlevel t_ctl.db error\ntarget t_ctl " + path + "\n");
+
+    Logger logger;
+    NamedLogger& http = get_logger("t_ctl.net.http");
+    NamedLogger& db = get_logger("t_ctl.db");
+    {
+        LogControl control(logger);
+        CHECK(control.start(ctl));
+        CHECK(control.applied_count() == 1);
+        CHECK(http.enabled(LogLevel::Debug));
+        CHECK(db.level() == LogLevel::Error);
+        LOGN(http, Debug, "retry\n");
+
+        // 行を消した設定は引き継ぐ状態に戻る
+        write_file(ctl, "level t_ctl.net debug\n");
+        CHECK(wait_applied(control, 2));
+        CHECK(db.level() == LogLevel::Info);
+        CHECK(http.enabled(LogLevel::Debug));
+
+        // 誤りのある版は反映しない
+        write_file(ctl, "level t_ctl.net trace\nlevel t_ctl.db verbose\n");
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (control.last_error().empty() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        CHECK(control.last_error().find(":2: unknown level 'verbose'") != std::string::npos);
+        CHECK(control.applied_count() == 2);
+        CHECK(!http.enabled(LogLevel::Trace));
+
+        write_file(ctl, "");
+        CHECK(wait_applied(control, 3));
+        CHECK(control.last_error().empty());
+        CHECK(!http.enabled(LogLevel::Debug));
+    }
+    logger.close_all();
+    CHECK(read_file(path) == "[DEBUG] t_ctl.net.http: retry\n");
+    std::remove(ctl.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(test_control_file_mute_and_flush) {
+    const std::string ctl = "control_mute.ctl";
+    const std::string muted = "control_muted.txt";
+    const std::string buffered = "control_buffered.txt";
+    std::remove(muted.c_str());
+    std::remove(buffered.c_str());
+    write_file(ctl, "mute " + muted + "\n");
+
+    Logger logger;
+    Logger::DurabilityPolicy policy;
+    policy.level = Logger::Durability::None;
+    logger.set_durability(buffered, policy);
+
+    LogControl control(logger);
+    CHECK(control.start(ctl));
+    CHECK(logger.is_muted(muted));
+    logger.log_to(muted, "dropped\n");
+    logger.log_to(buffered, "pending\n");
+    CHECK(read_file(buffered).empty());
+
+    // flush は新しく現れたときだけ実行し、mute を外すと書き込みが戻る
+    write_file(ctl, "flush\n");
+    CHECK(wait_applied(control, 2));
+    CHECK(!logger.is_muted(muted));
+    CHECK(read_file(buffered) == "pending\n");
+    logger.log_to(muted, "kept\n");
+    logger.log_to(buffered, "again\n");
+    write_file(ctl, "flush   # same action\n");
+    CHECK(wait_applied(control, 3));
+    CHECK(read_file(buffered) == "pending\n");
+    write_file(ctl, "flush 2\n");
+    CHECK(wait_applied(control, 4));
+    CHECK(read_file(buffered) == "pending\nagain\n");
+
+    control.stop();
+    logger.close_all();
+    CHECK(read_file(muted) == "kept\n");
+    std::remove(ctl.c_str());
+    std::remove(muted.c_str());
+    std::remove(buffered.c_str());
+}
+
+TEST(test_control_file_dump_tag) {
+    const std::string ctl = "control_dump.ctl";
+    const std::string dump = "control_dump.txt";
+    std::remove(dump.c_str());
+    write_file(ctl, "");
+
+    Logger logger;
+    logger.enable_flight_recorder();
+    LogControl control(logger);
+    CHECK(control.start(ctl));
+
+    // max_records を省いてタグだけを付けられる
+    logger.log("first\n");
+    write_file(ctl, "dump " + dump + " incident-1\n");
+    CHECK(wait_applied(control, 2));
+    CHECK(control.last_error().empty());
+    CHECK(read_lines(dump) == std::vector<std::string>{"first"});
+
+    logger.log("second\n");
+    logger.log("third\n");
+    write_file(ctl, "dump " + dump + " 1 incident-2\n");
+    CHECK(wait_applied(control, 3));
+    CHECK((read_lines(dump) == std::vector<std::string>{"first", "third"}));
+
+    control.stop();
+    logger.close_all();
+    std::remove(ctl.c_str());
+    std::remove(dump.c_str());
+}
+
+// ============================================================
+// 共有メモリ転送
+// ============================================================
+
+#ifndef _WIN32
+namespace {
+
+std::string test_shm_name(const char* tag) {
+    return "/logfunc-test-" + std::to_string(::getpid()) + "-" + tag;
+}
+
+bool shm_exists(const std::string& name) {
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    ::close(fd);
+    return true;
+}
+
+} // namespace
+
+TEST(test_shm_ring_roundtrip) {
+    const std::string path = "shm_roundtrip.txt";
+    const std::string name = test_shm_name("roundtrip");
+    std::remove(path.c_str());
+    ::shm_unlink(name.c_str());
+
+    Logger producer;
+    ShmRingOptions options;
+    options.name = name;
+    options.capacity = 4096;         // 何度も折り返す大きさ
+    options.block_when_full = true;  // 欠けずに届くことを確かめる
+    producer.set_sink(path, shm_ring_sink(options));
+    producer.log_to(path, "start\n");  // リングを作る
+
+    Logger output;
+    ShmLogWriter writer(output);
+    CHECK(writer.add(name));
+    CHECK(!writer.add(name));
+
+    std::atomic<bool> done{false};
+    std::thread daemon([&] {
+        while (writer.ring_count() > 0) {
+            if (writer.poll_once() == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&producer, &path, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                producer.log_to(path, "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    producer.close_all();  // リングに閉じた印が付き、デーモンが削除する
+    daemon.join();
+    output.close_all();
+
+    CHECK(done);
+    CHECK(!shm_exists(name));
+    auto lines = read_lines(path);
+    CHECK(!lines.empty() && lines.front() == "start");
+    lines.erase(lines.begin());
+    check_stress_lines(lines, kStressThreads, kStressRecords);
+    std::remove(path.c_str());
+}
+
+TEST(test_shm_ring_drops_when_full) {
+    const std::string path = "shm_drops.txt";
+    const std::string name = test_shm_name("drops");
+    std::remove(path.c_str());
+    ::shm_unlink(name.c_str());
+
+    Logger producer;
+    ShmRingOptions options;
+    options.name = name;
+    options.capacity = 4096;
+    producer.set_sink(path, shm_ring_sink(options));
+    for (int i = 0; i < 200; ++i) {
+        producer.log_to(path, "record ", i, " ", std::string(80, 'x'), "\n");
+    }
+    producer.log_to(path, std::string(3000, 'y'), "\n");  // リングの半分を超えるレコードは常に捨てる
+
+    Logger output;
+    ShmLogWriter writer(output);
+    CHECK(writer.add(name));
+    std::size_t written = writer.poll_once();
+    CHECK(written > 0 && written < 200);
+    CHECK(writer.ring_count() == 1);
+
+    producer.close_all();
+    writer.poll_once();
+    CHECK(writer.ring_count() == 0);
+    output.close_all();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == written + 1);
+    CHECK(lines.front() == "record 0 " + std::string(80, 'x'));
+    CHECK(lines.back().find("dropped " + std::to_string(201 - written) + " records") != std::string::npos);
+    CHECK(!shm_exists(name));
+    std::remove(path.c_str());
+}
+
+TEST(test_shm_ring_rejects_corrupted) {
+    const std::string path = "shm_corrupt.txt";
+    const std::string name = test_shm_name("corrupt");
+    std::remove(path.c_str());
+    ::shm_unlink(name.c_str());
+
+    Logger producer;
+    ShmRingOptions options;
+    options.name = name;
+    options.capacity = 4096;
+    producer.set_sink(path, shm_ring_sink(options));
+    for (int i = 0; i < 3; ++i) {
+        producer.log_to(path, "ok ", i, "\n");
+    }
+
+    // 2 件目の長さをリングより大きな値に書き換える
+    using logfunc_internal::ShmRingHeader;
+    std::size_t size = logfunc_internal::kShmDataOffset + 4096;
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    CHECK(fd >= 0);
+    void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    CHECK(base != MAP_FAILED);
+    auto& header = *static_cast<ShmRingHeader*>(base);
+    char* data = static_cast<char*>(base) + logfunc_internal::kShmDataOffset;
+    std::uint32_t bad_length = 0x7fff0000u;
+    std::memcpy(data + logfunc_internal::shm_record_size(5), &bad_length, sizeof(bad_length));
+
+    Logger output;
+    ShmLogWriter writer(output);
+    CHECK(writer.add(name));
+    CHECK(writer.poll_once() == 1);   // 壊れたレコードの手前まで書いてリングを外す
+    CHECK(writer.ring_count() == 0);
+    CHECK(!writer.add(name));
+    output.close_all();
+    CHECK(read_lines(path) == std::vector<std::string>{"ok 0"});
+
+    // tail から容量を超えて離れた head も受け付けない
+    header.head.store(header.tail.load() + 2 * 4096);
+    ShmRingReader reader(name);
+    std::size_t emitted = 0;
+    CHECK(reader.drain([&](std::string_view) { ++emitted; }) == 0);
+    CHECK(reader.corrupted() && emitted == 0);
+
+    ::munmap(base, size);
+    producer.close_all();
+    ::shm_unlink(name.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(test_shm_ring_survives_producer_crash) {
+    const std::string path = "shm_crash.txt";
+    const std::string name = test_shm_name("crash");
+    std::remove(path.c_str());
+    ::shm_unlink(name.c_str());
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        Logger logger;
+        ShmRingOptions options;
+        options.name = name;
+        logger.set_sink(path, shm_ring_sink(options));
+        for (int i = 0; i < 100; ++i) {
+            logger.log_to(path, "crash ", i, "\n");
+        }
+        std::_Exit(3);  // デストラクタを通らずに終了する
+    }
+    CHECK(pid > 0);
+    int status = 0;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 3);
+
+    Logger output;
+    ShmLogWriter writer(output);
+    CHECK(writer.add(name));
+    CHECK(writer.poll_once() == 100);
+    CHECK(writer.ring_count() == 0);
+    output.close_all();
+
+    auto lines = read_lines(path);
+    CHECK(lines.size() == 100);
+    CHECK(lines.front() == "crash 0" && lines.back() == "crash 99");
+    CHECK(!shm_exists(name));
+    std::remove(path.c_str());
+}
+#endif
+
+// ============================================================
+// Unix ドメインソケットシンク
+// ============================================================
+
+#ifndef _WIN32
+namespace {
+
+// syslog デーモンの代わりにレコードを受け取るローカルソケット
+class LocalSocketServer {
+public:
+    LocalSocketServer(std::string path, SocketMode mode) : path_(std::move(path)), mode_(mode) {
+        ::unlink(path_.c_str());
+        fd_ = ::socket(AF_UNIX, mode == SocketMode::Datagram ? SOCK_DGRAM : SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd_ < 0 || ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            (mode == SocketMode::Stream && ::listen(fd_, 4) != 0)) {
+            throw std::runtime_error("failed to bind test socket " + path_);
+        }
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~LocalSocketServer() {
+        stop_ = true;
+        thread_.join();
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+
+    // 条件を満たすまで（最大 5 秒）待って、受け取ったレコードを返す
+    template<typename Pred>
+    std::vector<std::string> wait_until(Pred pred) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::seconds(5), [&] { return pred(messages_); });
+        return messages_;
+    }
+
+    std::vector<std::string> wait_for(std::size_t count) {
+        return wait_until([count](const std::vector<std::string>& m) { return m.size() >= count; });
+    }
+
+private:
+    void run() {
+        int conn = -1;
+        std::string pending;
+        char buf[65536];
+        while (!stop_) {
+            pollfd pfd{conn >= 0 ? conn : fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 20) <= 0) continue;
+            if (mode_ == SocketMode::Datagram) {
+                ssize_t n = ::recv(fd_, buf, sizeof(buf), 0);
+                if (n >= 0) add(std::string(buf, static_cast<std::size_t>(n)));
+            } else if (conn < 0) {
+                conn = ::accept(fd_, nullptr, nullptr);
+            } else {
+                ssize_t n = ::recv(conn, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    ::close(conn);
+                    conn = -1;
+                    continue;
+                }
+                pending.append(buf, static_cast<std::size_t>(n));
+                std::size_t pos;
+                while ((pos = pending.find('\n')) != std::string::npos) {
+                    add(pending.substr(0, pos));
+                    pending.erase(0, pos + 1);
+                }
+            }
+        }
+        if (conn >= 0) ::close(conn);
+    }
+
+    void add(std::string message) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        messages_.push_back(std::move(message));
+        cv_.notify_all();
+    }
+
+    std::string path_;
+    SocketMode mode_;
+    int fd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<std::string> messages_;
+    std::thread thread_;
+};
+
+std::string test_socket_path(const char* tag) {
+    return "socket_" + std::string(tag) + "_" + std::to_string(::getpid()) + ".sock";
+}
+
+} // namespace
+
+TEST(test_socket_sink_datagram_syslog) {
+    const std::string socket_path = test_socket_path("dgram");
+    LocalSocketServer server(socket_path, SocketMode::Datagram);
+
+    SocketSinkOptions options;
+    options.socket_path = socket_path;
+    options.syslog = true;
+    options.tag = "unit";
+    options.batch_records = 16;
+    Logger logger;
+    logger.set_sink("syslog", unix_socket_sink(options));
+    for (int i = 0; i < 300; ++i) {
+        logger.log_to("syslog", "msg ", i, "\n");
+    }
+    logger.flush();
+
+    auto messages = server.wait_for(300);
+    CHECK(messages.size() == 300);
+    std::string header = "<14>unit[" + std::to_string(::getpid()) + "]: ";
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        CHECK(messages[i] == header + "msg " + std::to_string(i));
+    }
+}
+
+TEST(test_socket_sink_stream_threads) {
+    const std::string socket_path = test_socket_path("stream");
+    LocalSocketServer server(socket_path, SocketMode::Stream);
+
+    SocketSinkOptions options;
+    options.socket_path = socket_path;
+    options.mode = SocketMode::Stream;
+    Logger logger;
+    logger.set_sink("stream", unix_socket_sink(options));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kStressThreads; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < kStressRecords; ++i) {
+                auto payload = stress_payload(t, i);
+                logger.log_to("stream", "t=", t, " i=", i, " len=", payload.size(), " ", payload, "\n");
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    logger.flush();
+
+    check_stress_lines(server.wait_for(kStressThreads * kStressRecords), kStressThreads, kStressRecords);
+}
+
+TEST(test_socket_sink_reconnects) {
+    const std::string socket_path = test_socket_path("reconnect");
+    ::unlink(socket_path.c_str());
+
+    SocketSinkOptions options;
+    options.socket_path = socket_path;
+    options.reconnect_interval = std::chrono::milliseconds(20);
+    Logger logger;
+    logger.set_sink("syslog", unix_socket_sink(options));
+
+    // 受信側がいない間はキューに残る
+    for (int i = 0; i < 10; ++i) logger.log_to("syslog", "r ", i, "\n");
+    logger.flush();
+    {
+        LocalSocketServer server(socket_path, SocketMode::Datagram);
+        logger.flush();
+        auto messages = server.wait_for(10);
+        CHECK(messages.size() == 10);
+        CHECK(messages.front() == "r 0" && messages.back() == "r 9");
+    }
+
+    // 受信側が再起動しても、その間のレコードを含めて順に届く
+    for (int i = 10; i < 15; ++i) logger.log_to("syslog", "r ", i, "\n");
+    logger.flush();
+    LocalSocketServer restarted(socket_path, SocketMode::Datagram);
+    for (int i = 15; i < 20; ++i) logger.log_to("syslog", "r ", i, "\n");
+    logger.flush();
+    auto messages = restarted.wait_for(10);
+    CHECK(messages.size() == 10);
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        CHECK(messages[i] == "r " + std::to_string(10 + i));
+    }
+}
+
+TEST(test_socket_sink_drops_when_full) {
+    const std::string socket_path = test_socket_path("drops");
+    ::unlink(socket_path.c_str());
+
+    SocketSinkOptions options;
+    options.socket_path = socket_path;
+    options.buffer_bytes = 1000;
+    options.reconnect_interval = std::chrono::milliseconds(20);
+    Logger logger;
+    logger.set_sink("syslog", unix_socket_sink(options));
+    for (int i = 0; i < 100; ++i) {
+        logger.log_to("syslog", "record ", i, " ", std::string(40, 'x'), "\n");
+    }
+
+    LocalSocketServer server(socket_path, SocketMode::Datagram);
+    logger.flush();
+
+    // 届いたレコードと「捨てた件数」の合計が書いた件数になる
+    auto accounted = [](const std::vector<std::string>& messages) {
+        std::size_t total = 0;
+        for (const auto& m : messages) {
+            unsigned long dropped = 0;
+            total += std::sscanf(m.c_str(), "[logfunc] socket sink dropped %lu records", &dropped) == 1 ? dropped : 1;
+        }
+        return total;
+    };
+    auto messages = server.wait_until([&](const std::vector<std::string>& m) { return accounted(m) >= 100; });
+    CHECK(accounted(messages) == 100);
+    CHECK(messages.size() < 50);
+    CHECK(messages.front().rfind("[logfunc] socket sink dropped ", 0) == 0);
+    auto first = std::find_if(messages.begin(), messages.end(),
+                              [](const std::string& m) { return m.rfind("record ", 0) == 0; });
+    CHECK(first != messages.end() && *first == "record 0 " + std::string(40, 'x'));
+}
+#endif
+
+// ============================================================
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    // ハングしたテストでCIが止まらないようにするウォッチドッグ
+    std::thread([] {
+        std::this_thread::sleep_for(std::chrono::minutes(5));
+        std::cerr << "Test suite timed out\n";
+        std::_Exit(2);
+    }).detach();
+
+    std::cout << "\n========================================\n";
+    std::cout << "   logfunc Unit Test Suite\n";
+    std::cout << "========================================\n\n";
+
+    int test_count = 0;
+    int pass_count = 0;
+    for (const auto& test : test_registry()) {
+        if (filter && std::strstr(test.name, filter) == nullptr) {
+            continue;
+        }
+        ++test_count;
+        std::cout << "Running: " << test.name << std::endl;
+        try {
+            test.fn();
+            ++pass_count;
+            std::cout << "  [PASSED]\n";
+        } catch (const TestFailure& failure) {
+            std::cout << "  [FAILED] " << failure.message << "\n";
+        } catch (const std::exception& e) {
+            std::cout << "  [FAILED] exception: " << e.what() << "\n";
+        }
+    }
+
+    std::cout << "\n========================================\n";
+    std::cout << "   Results: " << pass_count << "/" << test_count << " tests passed\n";
+    std::cout << "========================================\n";
+
+    for (const char* path : {"test_log.txt", "custom_test.txt", "test_input.txt",
+                             "nonexistent_file_test.txt", "timeout_test.txt", "comment_test.txt",
+                             "float_test.txt", "double_test.txt", "custom_log.txt",
+                             "custom_input.txt", "in.txt", "log.txt"}) {
+        std::remove(path);
+    }
+
+    return (pass_count == test_count) ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#include "logfunc.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// ============================================================
+// 時刻インデックスを使ってログファイルから時間範囲を取り出すツール
+//
+// log_enable_time_index() で書いたログ（<ログ>.idx があるもの）が対象。
+// ファイル全体を読まず、インデックスで求めたバイト範囲だけを読む。
+//
+// ビルド: g++ -std=c++17 -O2 examples/log_range.cpp -I include -pthread -o log_range
+// 実行:   ./log_range <ログファイル> <開始> <終了>
+//         ./log_range <ログファイル> --index      （インデックスの内容を表示）
+//         時刻はエポックミリ秒、または UTC の YYYY-MM-DDTHH:MM:SS[.mmm]
+// ============================================================
+
+namespace {
+
+// 1970-01-01 からの日数（グレゴリオ暦）
+std::int64_t days_from_civil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+bool parse_time_ms(const char* text, std::int64_t& out) {
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, s = 0, ms = 0;
+    int n = std::sscanf(text, "%d-%d-%dT%d:%d:%d.%d", &y, &mo, &d, &h, &mi, &s, &ms);
+    if (n >= 6) {
+        std::int64_t days = days_from_civil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d));
+        out = ((days * 24 + h) * 60 + mi) * 60 * 1000 + s * 1000 + (n == 7 ? ms : 0);
+        return true;
+    }
+    char* end = nullptr;
+    long long value = std::strtoll(text, &end, 10);
+    if (end != text && *end == '\0') {
+        out = value;
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::strcmp(argv[2], "--index") == 0) {
+        auto index = Logger::TimeIndex::load(argv[1]);
+        for (const auto& entry : index.entries()) {
+            std::cout << entry.time_ms << " " << entry.offset << "\n";
+        }
+        return 0;
+    }
+
+    std::int64_t from = 0, to = 0;
+    if (argc != 4 || !parse_time_ms(argv[2], from) || !parse_time_ms(argv[3], to)) {
+        std::cerr << "usage: " << argv[0] << " <log file> <from> <to>\n"
+                  << "       " << argv[0] << " <log file> --index\n"
+                  << "time: epoch milliseconds or UTC YYYY-MM-DDTHH:MM:SS[.mmm]\n";
+        return 2;
+    }
+
+    auto index = Logger::TimeIndex::load(argv[1]);
+    if (index.entries().empty()) {
+        std::cerr << "no time index for " << argv[1] << " (expected " << argv[1] << ".idx)\n";
+        return 1;
+    }
+    std::cout << logfunc_internal::read_time_range(argv[1], from, to);
+    return 0;
+}
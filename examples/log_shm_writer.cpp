@@ -0,0 +1,75 @@
+#include "logfunc.h"
+#include "logfunc_shm.h"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================
+// 共有メモリリングからログファイルへ書き出すデーモン（POSIX のみ）
+//
+// アプリ側は log_set_sink(path, shm_ring_sink()) でリングに書くだけにし、
+// ファイル I/O はこのプロセスが行う。アプリが異常終了しても、リングに
+// 公開済みのレコードはここで書き出してからリングを削除する。
+//
+// ビルド: g++ -std=c++17 -O2 examples/log_shm_writer.cpp -I include -pthread -o log_shm_writer
+// 実行:   ./log_shm_writer [--interval ミリ秒] [--once] [リング名...]
+//         リング名を省略すると /dev/shm の logfunc-* を定期的に探す
+// ============================================================
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int interval_ms = 1;
+    bool once = false;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--once") == 0) {
+            once = true;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "usage: " << argv[0] << " [--interval ms] [--once] [ring name...]\n";
+            return 2;
+        } else {
+            names.push_back(argv[i][0] == '/' ? argv[i] : std::string("/") + argv[i]);
+        }
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    ShmLogWriter writer;
+    for (const auto& name : names) {
+        writer.add(name);
+    }
+
+    // 新しいリングは 100 回に 1 回だけ探す
+    for (unsigned round = 0; !g_stop; ++round) {
+        if (names.empty() && round % 100 == 0) {
+            writer.scan();
+        }
+        std::size_t written = writer.poll_once();
+        if (once) break;
+        if (!names.empty() && writer.ring_count() == 0) break;
+        if (written == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+    }
+    // 停止時に残りを書き出す
+    writer.poll_once();
+    log_close_all();
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <filesystem>
 #include <chrono>
@@ -11,12 +12,25 @@
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <new>
 #include <future>
 #include <optional>
 #include <condition_variable>
+#include <deque>
 #include <atomic>
 #include <functional>
 #include <vector>
+#include <array>
+#include <map>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -31,12 +45,36 @@
 #elif defined(__APPLE__)
 #include <CoreServices/CoreServices.h>
 #endif
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if __cplusplus >= 202002L
 #include <format>
 #define HAS_STD_FORMAT
 #endif
 
+// x86-64 では SSE2 / AVX2 のカーネルを使う（AVX2 は実行時に判定）
+// LOGFUNC_DISABLE_SIMD を定義するとスカラー実装のみになる
+#if !defined(LOGFUNC_DISABLE_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define LOGFUNC_SIMD_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LOGFUNC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LOGFUNC_TARGET_AVX2
+#endif
+#else
+#define LOGFUNC_SIMD_X86 0
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace logfunc_internal {
 
 inline auto get_file_modify_time(const std::filesystem::path& path) 
@@ -79,15 +117,19 @@ public:
      * @brief ファイル監視を開始
      * @param file_path 監視対象のファイルパス
      * @param callback ファイル変更時に呼ばれるコールバック
+     * @param whole_file_updates true なら書き込みの完了（close）と置き換え（rename）だけを通知する
+     *        （常に親ディレクトリを監視し、エディタによる置き換え保存も検知する。close を通知しない
+     *        Windows / macOS では、書き込みが kSettleTime 止まった時点を完了とみなす）
      * @return 監視開始に成功したかどうか
      */
-    bool start(const std::filesystem::path& file_path, ChangeCallback callback) {
-        if (running_.load()) {
-            stop();
-        }
+    bool start(const std::filesystem::path& file_path, ChangeCallback callback,
+               bool whole_file_updates = false) {
+        std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mtx_);
+        stop_locked();
 
         file_path_ = file_path;
         callback_ = std::move(callback);
+        whole_file_updates_ = whole_file_updates;
         running_.store(true);
 
 #ifdef _WIN32
@@ -106,29 +148,8 @@ public:
      * @brief ファイル監視を停止
      */
     void stop() {
-        if (!running_.load()) {
-            return;
-        }
-        running_.store(false);
-        
-        // 条件変数で待機中のスレッドを起こす
-        {
-            std::lock_guard<std::mutex> lock(cv_mtx_);
-            change_detected_.store(true);
-        }
-        cv_.notify_all();
-
-#ifdef _WIN32
-        stop_windows();
-#elif defined(__linux__)
-        stop_linux();
-#elif defined(__APPLE__)
-        stop_macos();
-#endif
-
-        if (watcher_thread_.joinable()) {
-            watcher_thread_.join();
-        }
+        std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mtx_);
+        stop_locked();
     }
 
     /**
@@ -184,14 +205,54 @@ public:
 #endif
     }
 
+    // close の通知がない環境で、書き込みが止まってから完了とみなすまでの時間
+    static constexpr std::chrono::milliseconds kSettleTime{100};
+
 private:
     std::filesystem::path file_path_;
     ChangeCallback callback_;
+    bool whole_file_updates_ = false;
     std::atomic<bool> running_{false};
     std::atomic<bool> change_detected_{false};
     std::thread watcher_thread_;
     std::mutex cv_mtx_;
     std::condition_variable cv_;
+    std::mutex lifecycle_mtx_;  // start/stop の同時呼び出しを直列化
+
+    // lifecycle_mtx_ を保持した状態で呼ぶこと
+    void stop_locked() {
+        if (!running_.load()) {
+            return;
+        }
+        running_.store(false);
+        
+        // 条件変数で待機中のスレッドを起こす
+        {
+            std::lock_guard<std::mutex> lock(cv_mtx_);
+            change_detected_.store(true);
+        }
+        cv_.notify_all();
+
+        // 監視スレッドに停止を通知し、終了を待ってからOSリソースを解放する
+        // （スレッドが使用中のハンドルを先に閉じると競合するため）
+#ifdef _WIN32
+        signal_stop_windows();
+#elif defined(__linux__)
+        signal_stop_linux();
+#elif defined(__APPLE__)
+        stop_macos();
+#endif
+
+        if (watcher_thread_.joinable()) {
+            watcher_thread_.join();
+        }
+
+#ifdef _WIN32
+        cleanup_windows();
+#elif defined(__linux__)
+        cleanup_linux();
+#endif
+    }
 
 #ifdef _WIN32
     HANDLE dir_handle_ = INVALID_HANDLE_VALUE;
@@ -236,38 +297,66 @@ private:
         overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 
         auto filename = file_path_.filename().wstring();
+        // 置き換え保存を拾うため、完了だけを見る場合は名前の変更も監視する
+        DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+        if (whole_file_updates_) {
+            filter |= FILE_NOTIFY_CHANGE_FILE_NAME;
+        }
+        bool issued = false;
+        bool settling = false;   // 書き込み途中かもしれない変更がある
+        auto settle_deadline = std::chrono::steady_clock::now();
 
         while (running_.load()) {
-            ResetEvent(overlapped.hEvent);
-
-            BOOL result = ReadDirectoryChangesW(
-                dir_handle_,
-                buffer.data(),
-                buffer_size,
-                FALSE, // サブディレクトリは監視しない
-                FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
-                nullptr,
-                &overlapped,
-                nullptr
-            );
-
-            if (!result) {
-                break;
+            if (!issued) {
+                ResetEvent(overlapped.hEvent);
+                BOOL result = ReadDirectoryChangesW(
+                    dir_handle_,
+                    buffer.data(),
+                    buffer_size,
+                    FALSE, // サブディレクトリは監視しない
+                    filter,
+                    nullptr,
+                    &overlapped,
+                    nullptr
+                );
+                if (!result) {
+                    break;
+                }
+                issued = true;
             }
 
+            // 同じディレクトリの他のファイルの変更で待ち時間が延びないよう、期限から残りを求める
+            DWORD timeout = INFINITE;
+            if (settling) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    settle_deadline - std::chrono::steady_clock::now()).count();
+                timeout = left > 0 ? static_cast<DWORD>(left) : 0;
+            }
             HANDLE handles[] = { overlapped.hEvent, stop_event_ };
-            DWORD wait_result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+            DWORD wait_result = WaitForMultipleObjects(2, handles, FALSE, timeout);
 
-            if (wait_result == WAIT_OBJECT_0) {
+            if (wait_result == WAIT_TIMEOUT) {
+                settling = false;
+                notify_change();
+            } else if (wait_result == WAIT_OBJECT_0) {
                 // 変更検知
+                issued = false;
                 DWORD bytes_returned = 0;
                 if (GetOverlappedResult(dir_handle_, &overlapped, &bytes_returned, FALSE)) {
                     auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(buffer.data());
                     do {
                         std::wstring changed_filename(info->FileName, info->FileNameLength / sizeof(WCHAR));
                         if (changed_filename == filename) {
-                            notify_change();
-                            break;
+                            if (!whole_file_updates_ || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                                settling = false;
+                                notify_change();
+                                break;
+                            }
+                            if (info->Action != FILE_ACTION_REMOVED &&
+                                info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+                                settling = true;
+                                settle_deadline = std::chrono::steady_clock::now() + kSettleTime;
+                            }
                         }
                         if (info->NextEntryOffset == 0) break;
                         info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(
@@ -281,15 +370,19 @@ private:
             }
         }
 
+        // 発行済みの非同期I/Oは発行したスレッドでキャンセルする
+        CancelIo(dir_handle_);
         CloseHandle(overlapped.hEvent);
     }
 
-    void stop_windows() {
+    void signal_stop_windows() {
         if (stop_event_) {
             SetEvent(stop_event_);
         }
+    }
+
+    void cleanup_windows() {
         if (dir_handle_ != INVALID_HANDLE_VALUE) {
-            CancelIo(dir_handle_);
             CloseHandle(dir_handle_);
             dir_handle_ = INVALID_HANDLE_VALUE;
         }
@@ -313,7 +406,7 @@ private:
 
         // ファイルまたは親ディレクトリを監視
         std::string watch_path;
-        if (std::filesystem::exists(file_path_)) {
+        if (std::filesystem::exists(file_path_) && !whole_file_updates_) {
             watch_path = file_path_.string();
         } else {
             auto dir_path = file_path_.parent_path();
@@ -321,11 +414,10 @@ private:
             watch_path = dir_path.string();
         }
 
-        watch_fd_ = inotify_add_watch(
-            inotify_fd_,
-            watch_path.c_str(),
-            IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO
-        );
+        // 完了した書き込みだけを見る場合、同じディレクトリのログへの追記では起きない
+        std::uint32_t mask = whole_file_updates_ ? (IN_CLOSE_WRITE | IN_MOVED_TO)
+                                                 : (IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO);
+        watch_fd_ = inotify_add_watch(inotify_fd_, watch_path.c_str(), mask);
 
         if (watch_fd_ < 0) {
             close(inotify_fd_);
@@ -390,11 +482,14 @@ private:
         }
     }
 
-    void stop_linux() {
+    void signal_stop_linux() {
         if (pipe_fd_[1] >= 0) {
             char c = 'x';
             [[maybe_unused]] auto _ = write(pipe_fd_[1], &c, 1);
         }
+    }
+
+    void cleanup_linux() {
         if (watch_fd_ >= 0 && inotify_fd_ >= 0) {
             inotify_rm_watch(inotify_fd_, watch_fd_);
             watch_fd_ = -1;
@@ -460,6 +555,9 @@ private:
         queue_ = dispatch_queue_create("com.logfunc.filewatcher", DISPATCH_QUEUE_SERIAL);
         FSEventStreamSetDispatchQueue(stream_, queue_);
         FSEventStreamStart(stream_);
+        if (whole_file_updates_) {
+            watcher_thread_ = std::thread([this] { watch_settle_macos(); });
+        }
 
         return true;
     }
@@ -469,7 +567,7 @@ private:
         void* info,
         size_t num_events,
         void* event_paths,
-        const FSEventStreamEventFlags*,
+        const FSEventStreamEventFlags* event_flags,
         const FSEventStreamEventId*
     ) {
         auto* watcher = static_cast<FileWatcher*>(info);
@@ -478,10 +576,54 @@ private:
 
         for (size_t i = 0; i < num_events; ++i) {
             std::filesystem::path event_path(paths[i]);
-            if (event_path.filename().string() == filename) {
+            if (event_path.filename().string() != filename) {
+                continue;
+            }
+            if (!watcher->whole_file_updates_) {
+                watcher->notify_change();
+                break;
+            }
+            std::error_code ec;
+            if (!std::filesystem::exists(watcher->file_path_, ec)) {
+                continue;  // 削除・移動元
+            }
+            if (event_flags[i] & kFSEventStreamEventFlagItemRenamed) {
                 watcher->notify_change();
                 break;
             }
+            watcher->mark_settling();
+        }
+    }
+
+    // close を通知しないため、書き込みが kSettleTime 止まったら完了とみなす
+    bool settling_ = false;  // cv_mtx_ で保護
+    std::chrono::steady_clock::time_point settle_deadline_;
+
+    void mark_settling() {
+        {
+            std::lock_guard<std::mutex> lock(cv_mtx_);
+            settling_ = true;
+            settle_deadline_ = std::chrono::steady_clock::now() + kSettleTime;
+        }
+        cv_.notify_all();
+    }
+
+    void watch_settle_macos() {
+        std::unique_lock<std::mutex> lock(cv_mtx_);
+        while (running_.load()) {
+            if (!settling_) {
+                cv_.wait(lock, [this] { return settling_ || !running_.load(); });
+                continue;
+            }
+            auto deadline = settle_deadline_;
+            if (std::chrono::steady_clock::now() < deadline) {
+                cv_.wait_until(lock, deadline);
+                continue;
+            }
+            settling_ = false;
+            lock.unlock();
+            notify_change();
+            lock.lock();
         }
     }
 
@@ -539,243 +681,3681 @@ private:
     }
 
     void notify_change() {
+        // 待機側が起床した時点でコールバックの結果が見えるよう、先に呼び出す
+        if (callback_) {
+            callback_();
+        }
+
         {
             std::lock_guard<std::mutex> lock(cv_mtx_);
             change_detected_.store(true);
         }
         cv_.notify_all();
-        
-        if (callback_) {
-            callback_();
-        }
     }
 };
 
-} // namespace logfunc_internal
 
-/**
- * @brief ログ機能を提供するLoggerクラス
- * 
- * 状態をインスタンス変数として管理し、複数のロガーインスタンスを
- * 同時に使用可能。テスト容易性と拡張性を向上させる設計。
- */
-class Logger {
-public:
-    // InputFileCacheをpublicに移動（loginf_try等で使用）
-    struct InputFileCache {
-        std::filesystem::file_time_type last_check_time;
-        std::filesystem::file_time_type last_modify_time;
-        std::chrono::steady_clock::time_point last_access;
-        bool file_exists = false;
-        static constexpr std::chrono::milliseconds cache_duration{10};
-    };
+// ============================================================
+// メトリクス（計測）
+// ============================================================
 
-private:
-    // ファイルキャッシュ（インスタンス変数）
-    std::unordered_map<std::string, std::unique_ptr<std::ofstream>> handles_;
-    mutable std::mutex mtx_;
-    std::unique_ptr<std::ofstream> null_stream_;
-    bool silent_mode_ = true;
-    
-    // パス設定（インスタンス変数）
-    std::string log_file_path_ = "log.txt";
-    std::string input_file_path_ = "in.txt";
-    
-    // 入力ファイルキャッシュ（インスタンス変数）
-    InputFileCache input_cache_{
-        std::filesystem::file_time_type::min(),
-        std::filesystem::file_time_type::min(),
-        std::chrono::steady_clock::time_point{},
-        false
-    };
-    
-    // ファイル監視機能（イベント駆動方式）
-    std::unique_ptr<logfunc_internal::FileWatcher> file_watcher_;
-    bool use_event_driven_ = true;  // イベント駆動方式を使用するか
+// 64bit値のビット幅（0 の場合は 0）
+inline unsigned bit_width64(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return v == 0 ? 0u : static_cast<unsigned>(64 - __builtin_clzll(v));
+#else
+    unsigned n = 0;
+    while (v) { v >>= 1; ++n; }
+    return n;
+#endif
+}
 
-    std::ofstream& get_null_stream() {
-        if (!null_stream_) {
-            null_stream_ = std::make_unique<std::ofstream>();
-        }
-        return *null_stream_;
+// 最下位から連続する 0 ビットの数（v != 0 であること）
+inline unsigned count_trailing_zeros32(unsigned v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctz(v));
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return static_cast<unsigned>(index);
+#else
+    unsigned n = 0;
+    while ((v & 1u) == 0) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+// JSON でエスケープが必要なバイトか（'"', '\\', 制御文字）
+inline bool json_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// [p, end) でエスケープが必要な最初のバイトを返す（なければ end）
+inline const char* find_json_escape_scalar(const char* p, const char* end) {
+    while (p < end && !json_needs_escape(static_cast<unsigned char>(*p))) {
+        ++p;
     }
-    
-    std::ofstream& get_or_open_internal(const std::string& path_str) {
-        auto it = handles_.find(path_str);
-        if (it != handles_.end() && it->second && it->second->is_open()) {
-            return *it->second;
-        }
-        
-        auto stream = std::make_unique<std::ofstream>(
-            path_str, std::ios::app
-        );
-        
-        if (stream && stream->is_open()) {
-            stream->rdbuf()->pubsetbuf(nullptr, 0);
-            auto& ref = *stream;
-            handles_[path_str] = std::move(stream);
-            return ref;
-        }
-        if (silent_mode_) {
-            std::cerr << "[logfunc] Warning: Failed to open file: " << path_str << std::endl;
-            return get_null_stream();  
-        } else {
-            throw std::runtime_error("Failed to open file: " + path_str);
+    return p;
+}
+
+#if LOGFUNC_SIMD_X86
+// 16 バイトずつ '"' / '\\' / 0x00-0x1F を比較し、該当位置をビットマスクで得る
+inline const char* find_json_escape_sse2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctl_max = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, ctl_max), v));  // v <= 0x1F（符号なし）
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + count_trailing_zeros32(static_cast<unsigned>(mask));
         }
+        p += 16;
     }
+    return find_json_escape_scalar(p, end);
+}
 
-public:
-    Logger() = default;
-    
-    // コピー禁止（ファイルハンドルを持つため）
-    Logger(const Logger&) = delete;
-    Logger& operator=(const Logger&) = delete;
-    
-    // ムーブは許可
-    Logger(Logger&&) = default;
-    Logger& operator=(Logger&&) = default;
-    
-    ~Logger() {
-        close_all();
+LOGFUNC_TARGET_AVX2
+inline const char* find_json_escape_avx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i ctl_max = _mm256_set1_epi8(0x1F);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl_max), v));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return p + count_trailing_zeros32(mask);
+        }
+        p += 32;
     }
+    return find_json_escape_sse2(p, end);
+}
 
-    // === パス設定 ===
-    void set_log_path(std::string_view log_path) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        log_file_path_ = log_path;
+inline bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // OS が YMM レジスタを保存するか（XCR0 の bit 1, 2）
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+#endif // LOGFUNC_SIMD_X86
+
+using FindJsonEscapeFn = const char* (*)(const char*, const char*);
+
+// 実行中の CPU で使える最速の実装（初回呼び出し時に一度だけ判定する）
+inline FindJsonEscapeFn json_escape_kernel() {
+#if LOGFUNC_SIMD_X86
+    static const FindJsonEscapeFn fn = cpu_has_avx2() ? &find_json_escape_avx2 : &find_json_escape_sse2;
+    return fn;
+#else
+    return &find_json_escape_scalar;
+#endif
+}
+
+inline const char* find_json_escape(const char* p, const char* end) {
+    // 短い文字列はディスパッチのコストの方が大きい
+    if (end - p < 16) {
+        return find_json_escape_scalar(p, end);
     }
-    
-    std::string get_log_path() const {
-        std::lock_guard<std::mutex> lock(mtx_);
-        return log_file_path_;
+    return json_escape_kernel()(p, end);
+}
+
+// エスケープ済みの内容を引用符なしで追記する
+// エスケープ不要な区間はまとめて append する
+inline void append_json_escaped(std::string& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    const char* p = s.data();
+    const char* end = p + s.size();
+    while (p < end) {
+        const char* run = p;
+        p = find_json_escape(p, end);
+        out.append(run, static_cast<std::size_t>(p - run));
+        if (p == end) {
+            break;
+        }
+        auto c = static_cast<unsigned char>(*p++);
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                out.append(esc, sizeof(esc));
+            }
+        }
     }
-    
-    void set_input_path(std::string_view input_path) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        input_file_path_ = input_path;
+}
+
+// JSON文字列リテラルとして追記する（引用符付き）
+inline void append_json_string(std::string& out, std::string_view s) {
+    out += '"';
+    append_json_escaped(out, s);
+    out += '"';
+}
+
+// === 数値の文字列化（ロケール非依存・ヒープ確保なし） ===
+
+// "00" "01" ... "99" を連結した表（2桁ずつ変換するために使う）
+inline constexpr char kDigitPairs[] =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+// v を end の直前から書き込み、先頭の位置を返す（end の前に 20 バイト必要）
+inline char* format_uint_backward(char* end, std::uint64_t v) {
+    char* p = end;
+    while (v >= 100) {
+        auto idx = static_cast<std::size_t>(v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        p[0] = kDigitPairs[idx];
+        p[1] = kDigitPairs[idx + 1];
     }
-    
-    std::string get_input_path() const {
-        std::lock_guard<std::mutex> lock(mtx_);
-        return input_file_path_;
+    if (v >= 10) {
+        auto idx = static_cast<std::size_t>(v) * 2;
+        p -= 2;
+        p[0] = kDigitPairs[idx];
+        p[1] = kDigitPairs[idx + 1];
+    } else {
+        *--p = static_cast<char>('0' + v);
     }
+    return p;
+}
 
-    // === ファイルキャッシュ操作 ===
-    std::ofstream& get_or_open(std::string_view path) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        std::string path_str{path};
-        return get_or_open_internal(path_str);
-    }
-    
-    void write_atomic(std::string_view path, const std::string& content) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        std::string path_str{path};
-        auto& stream = get_or_open_internal(path_str);
-        stream << content;
-        stream.flush();
+inline unsigned count_decimal_digits(std::uint64_t v) {
+    unsigned n = 1;
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
     }
+}
 
-    class LockedStream {
-    private:
-        std::ofstream& stream_;
-        std::unique_lock<std::mutex> lock_;
-        
-    public:
-        LockedStream(std::ofstream& stream, std::unique_lock<std::mutex> lock)
-            : stream_(stream), lock_(std::move(lock)) {}
-        
-        template<typename T>
-        LockedStream& operator<<(T&& value) {
-            stream_ << std::forward<T>(value);
-            return *this;
-        }
-        
-        void flush() { stream_.flush(); }
+// 以下の write_* は p から書き込み、書き込んだ末尾を返す
 
-        LockedStream(LockedStream&&) = default;
-        LockedStream& operator=(LockedStream&&) = default;
-        LockedStream(const LockedStream&) = delete;
-        LockedStream& operator=(const LockedStream&) = delete;
-    };
+// 最大 20 文字
+inline char* write_uint(char* p, std::uint64_t v) {
+    char* end = p + count_decimal_digits(v);
+    format_uint_backward(end, v);
+    return end;
+}
 
-    LockedStream get_locked_stream(std::string_view path) {
-        std::unique_lock<std::mutex> lock(mtx_);
-        std::string path_str{path};
-        auto& stream = get_or_open_internal(path_str);
-        return LockedStream(stream, std::move(lock));
+// 最大 20 文字（符号込み）
+inline char* write_int(char* p, std::int64_t v) {
+    // 負数は符号なしで絶対値を求める（INT64_MIN でもオーバーフローしない）
+    auto magnitude = static_cast<std::uint64_t>(v);
+    if (v < 0) {
+        *p++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    return write_uint(p, magnitude);
+}
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define LOGFUNC_HAS_FLOAT_TO_CHARS
+#endif
+
+// write_floating が書き込む最大文字数（有効桁は 40 桁で打ち切る）
+inline constexpr std::size_t kMaxFloatChars = 64;
+
+/**
+ * @brief 浮動小数点数を書き込む（NaN / 無限大は "nan" / "inf" / "-inf"）
+ *
+ * @param precision 有効桁数（%g 相当）。0 以下なら往復可能な最短表現
+ */
+template<typename F>
+inline char* write_floating(char* p, F v, int precision = 0) {
+    if (std::isnan(v)) {
+        std::memcpy(p, "nan", 3);
+        return p + 3;
+    }
+    if (std::isinf(v)) {
+        if (v < 0) {
+            std::memcpy(p, "-inf", 4);
+            return p + 4;
+        }
+        std::memcpy(p, "inf", 3);
+        return p + 3;
+    }
+    if (precision > 40) {
+        precision = 40;
+    }
+#ifdef LOGFUNC_HAS_FLOAT_TO_CHARS
+    auto r = precision > 0
+        ? std::to_chars(p, p + kMaxFloatChars, v, std::chars_format::general, precision)
+        : std::to_chars(p, p + kMaxFloatChars, v);
+    return r.ptr;
+#else
+    // to_chars が無い環境: 元の値に戻る最小の桁数を探す
+    int n;
+    if (precision > 0) {
+        n = std::snprintf(p, kMaxFloatChars, "%.*g", precision, static_cast<double>(v));
+    } else {
+        constexpr int min_digits = std::numeric_limits<F>::digits10;
+        constexpr int max_digits = std::numeric_limits<F>::max_digits10;
+        for (int digits = min_digits; ; ++digits) {
+            n = std::snprintf(p, kMaxFloatChars, "%.*g", digits, static_cast<double>(v));
+            if (digits >= max_digits || static_cast<F>(std::strtod(p, nullptr)) == v) {
+                break;
+            }
+        }
+    }
+    return p + n;
+#endif
+}
+
+inline void append_uint(std::string& out, std::uint64_t v) {
+    char buf[20];
+    out.append(buf, write_uint(buf, v));
+}
+
+inline void append_int(std::string& out, std::int64_t v) {
+    char buf[20];
+    out.append(buf, write_int(buf, v));
+}
+
+inline void append_double(std::string& out, double v, int precision = 0) {
+    char buf[kMaxFloatChars];
+    out.append(buf, write_floating(buf, v, precision));
+}
+
+// === テキスト出力の高速経路（iostream を経由しない） ===
+
+// 高速経路で文字列化できる型か（それ以外を含む呼び出しは ostringstream を使う）
+template<typename T>
+struct is_fast_text_arg {
+    using V = std::remove_cv_t<std::remove_reference_t<T>>;
+    static constexpr bool value =
+        std::is_arithmetic_v<V> ||
+        std::is_same_v<std::decay_t<V>, const char*> || std::is_same_v<std::decay_t<V>, char*> ||
+        std::is_same_v<V, std::string> || std::is_same_v<V, std::string_view>;
+};
+
+template<typename T>
+inline constexpr bool is_fast_text_arg_v = is_fast_text_arg<T>::value;
+
+// char の配列（文字列リテラルを含む）か
+template<typename T>
+inline constexpr bool is_char_array_v =
+    std::is_array_v<std::remove_reference_t<T>> &&
+    std::is_same_v<std::remove_cv_t<std::remove_extent_t<std::remove_reference_t<T>>>, char>;
+
+/**
+ * @brief 文字列化したときの最大文字数がコンパイル時に決まる型の上限（決まらなければ 0）
+ *
+ * 文字配列（文字列リテラル）は要素数、整数は桁数＋符号、浮動小数点数は kMaxFloatChars。
+ */
+template<typename T>
+struct fixed_text_size {
+    using V = std::remove_cv_t<std::remove_reference_t<T>>;
+    static constexpr std::size_t value = [] {
+        if constexpr (std::is_same_v<V, bool> || std::is_same_v<V, char> ||
+                      std::is_same_v<V, signed char> || std::is_same_v<V, unsigned char>) {
+            return std::size_t{1};
+        } else if constexpr (std::is_floating_point_v<V>) {
+            return kMaxFloatChars;
+        } else if constexpr (std::is_integral_v<V>) {
+            return std::size_t{20};
+        } else if constexpr (is_char_array_v<V>) {
+            // 終端 '\0' が無い配列でも範囲内に収まるよう N とする
+            return std::extent_v<V>;
+        } else {
+            return std::size_t{0};
+        }
+    }();
+    static constexpr bool is_fixed = std::is_arithmetic_v<V> || is_char_array_v<V>;
+};
+
+// スタック上で整形する呼び出しの上限（これを超える場合はスレッドごとのバッファを使う）
+inline constexpr std::size_t kMaxStackTextSize = 1024;
+
+/**
+ * @brief 全引数が固定長の型なら出力の上限サイズ、そうでなければ 0
+ */
+template<typename... Args>
+inline constexpr std::size_t fixed_text_bound_v = [] {
+    if constexpr (sizeof...(Args) > 0 && (fixed_text_size<Args>::is_fixed && ...)) {
+        constexpr std::size_t total = (fixed_text_size<Args>::value + ...);
+        return total > 0 && total <= kMaxStackTextSize ? total : std::size_t{0};
+    } else {
+        return std::size_t{0};
+    }
+}();
+
+/**
+ * @brief 引数が文字配列（文字列リテラル）1つだけか
+ */
+template<typename... Args>
+inline constexpr bool is_single_char_array_v = sizeof...(Args) == 1 && (is_char_array_v<Args> && ...);
+
+/**
+ * @brief 文字配列の内容（終端 '\0' の手前まで、配列の範囲を超えない）
+ *
+ * const の配列（文字列リテラル）は長さをコンパイル時の N - 1 とする。末尾の 2 バイトだけ確かめ、
+ * 余白のある const 配列（const char buf[32] = "abc" など）と char[N] のバッファは '\0' を探す。
+ */
+template<typename A>
+inline std::string_view char_array_view(A&& value) {
+    using Array = std::remove_reference_t<A>;
+    constexpr std::size_t N = std::extent_v<Array>;
+    if constexpr (std::is_const_v<std::remove_extent_t<Array>>) {
+        if (value[N - 1] == '\0' && (N == 1 || value[N - 2] != '\0')) {
+            return std::string_view(value, N - 1);
+        }
+    }
+    const void* nul = std::memchr(value, '\0', N);
+    return std::string_view(value, nul ? static_cast<std::size_t>(static_cast<const char*>(nul) - value) : N);
+}
+
+/**
+ * @brief 1引数を operator<< と同じ見た目で p に書き込む（fixed_text_size の型のみ）
+ *
+ * 浮動小数点数だけは precision が 0 以下のとき往復可能な最短表現になる
+ * （operator<< の既定は有効桁 6）。
+ */
+template<typename T>
+inline char* write_text(char* p, T&& value, int precision) {
+    using V = std::decay_t<T>;
+    if constexpr (std::is_same_v<V, bool>) {
+        *p++ = value ? '1' : '0';
+        return p;
+    } else if constexpr (std::is_same_v<V, char> || std::is_same_v<V, signed char> ||
+                         std::is_same_v<V, unsigned char>) {
+        *p++ = static_cast<char>(value);
+        return p;
+    } else if constexpr (std::is_same_v<V, float>) {
+        return write_floating(p, value, precision);
+    } else if constexpr (std::is_floating_point_v<V>) {
+        // long double は double に丸める
+        return write_floating(p, static_cast<double>(value), precision);
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+        return write_int(p, static_cast<std::int64_t>(value));
+    } else if constexpr (std::is_integral_v<V>) {
+        return write_uint(p, static_cast<std::uint64_t>(value));
+    } else {
+        // 文字配列
+        auto text = char_array_view(value);
+        std::memcpy(p, text.data(), text.size());
+        return p + text.size();
+    }
+}
+
+/**
+ * @brief 1引数を operator<< と同じ見た目で追記する
+ */
+template<typename T>
+inline void append_text(std::string& out, T&& value, int precision) {
+    using V = std::decay_t<T>;
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    if constexpr (std::is_arithmetic_v<V>) {
+        char buf[kMaxFloatChars];
+        out.append(buf, write_text(buf, value, precision));
+    } else if constexpr (std::is_pointer_v<U>) {
+        if (value) {
+            out += value;
+        }
+    } else if constexpr (std::is_array_v<U>) {
+        out += char_array_view(value);
+    } else {
+        out += value;
+    }
+}
+
+// 整形用バッファ（スレッドごとに容量を使い回す）
+inline std::string& format_buffer() {
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+// === 構造化ログ ===
+
+/**
+ * @brief 構造化ログの出力形式
+ */
+enum class StructuredFormat {
+    Text,    // msg key=value ...（人が読む用）
+    Json,    // JSON Lines: {"ts":...,"msg":"...","key":value}
+    Logfmt   // ts=... msg="..." key=value
+};
+
+/**
+ * @brief 型付きのキー/値フィールド（kv() で生成する）
+ *
+ * キーと文字列値は呼び出し元の文字列を参照するだけでコピーしない。
+ * そのため Field はログ呼び出しの式の中でだけ使うこと。
+ */
+struct Field {
+    enum class Type { Null, Bool, Int, UInt, Double, Char, String, Owned };
+
+    std::string_view key;
+    Type type = Type::Null;
+    union {
+        bool b;
+        std::int64_t i;
+        std::uint64_t u;
+        double d;
+        char c;
+    };
+    std::string_view str;
+    std::string owned;  // operator<< でしか文字列化できない型の値
+
+    Field() : i(0) {}
+};
+
+// logfmt のキーとして使えない文字を '_' に置き換えて追記する
+inline void append_logfmt_key(std::string& out, std::string_view key) {
+    if (key.empty()) {
+        out += '_';
+        return;
+    }
+    for (char ch : key) {
+        auto c = static_cast<unsigned char>(ch);
+        out += (c <= ' ' || c == '=' || c == '"' || c == 0x7F) ? '_' : ch;
+    }
+}
+
+// logfmt の値を追記する（空白・'='・'"'・制御文字を含む場合は引用符で囲む）
+inline void append_logfmt_value(std::string& out, std::string_view s) {
+    bool quote = s.empty();
+    for (char ch : s) {
+        auto c = static_cast<unsigned char>(ch);
+        if (c <= ' ' || c == '=' || c == '"' || c == '\\' || c == 0x7F) {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        out += s;
+        return;
+    }
+    out += '"';
+    append_json_escaped(out, s);
+    out += '"';
+}
+
+// フィールド値を文字列として見た内容（文字列系の型のみ）
+inline std::string_view field_text(const Field& f) {
+    switch (f.type) {
+        case Field::Type::Char:  return std::string_view(&f.c, 1);
+        case Field::Type::String: return f.str;
+        case Field::Type::Owned: return f.owned;
+        default: return {};
+    }
+}
+
+// 数値・真偽値・null を追記する（JSON では NaN / 無限大を null にする）
+inline void append_scalar(std::string& out, const Field& f, bool json) {
+    switch (f.type) {
+        case Field::Type::Null:   out += "null"; break;
+        case Field::Type::Bool:   out += f.b ? "true" : "false"; break;
+        case Field::Type::Int:    append_int(out, f.i); break;
+        case Field::Type::UInt:   append_uint(out, f.u); break;
+        case Field::Type::Double:
+            if (json && !std::isfinite(f.d)) {
+                out += "null";
+            } else {
+                append_double(out, f.d);
+            }
+            break;
+        default: break;
+    }
+}
+
+inline bool is_text_field(const Field& f) {
+    return f.type == Field::Type::Char || f.type == Field::Type::String ||
+           f.type == Field::Type::Owned;
+}
+
+/**
+ * @brief メッセージとフィールドを1行（改行付き）に整形して out に追記する
+ *
+ * @param timestamp_ms エポックからのミリ秒。負の値なら ts を出力しない
+ */
+inline void encode_structured(std::string& out, StructuredFormat format,
+                              std::int64_t timestamp_ms, std::string_view message,
+                              const Field* const* fields, std::size_t count) {
+    switch (format) {
+        case StructuredFormat::Json:
+            out += '{';
+            if (timestamp_ms >= 0) {
+                out += "\"ts\":";
+                append_int(out, timestamp_ms);
+                out += ',';
+            }
+            out += "\"msg\":";
+            append_json_string(out, message);
+            for (std::size_t n = 0; n < count; ++n) {
+                out += ',';
+                append_json_string(out, fields[n]->key);
+                out += ':';
+                if (is_text_field(*fields[n])) {
+                    append_json_string(out, field_text(*fields[n]));
+                } else {
+                    append_scalar(out, *fields[n], true);
+                }
+            }
+            out += "}\n";
+            break;
+
+        case StructuredFormat::Logfmt:
+            if (timestamp_ms >= 0) {
+                out += "ts=";
+                append_int(out, timestamp_ms);
+                out += ' ';
+            }
+            out += "msg=";
+            append_logfmt_value(out, message);
+            for (std::size_t n = 0; n < count; ++n) {
+                out += ' ';
+                append_logfmt_key(out, fields[n]->key);
+                out += '=';
+                if (is_text_field(*fields[n])) {
+                    append_logfmt_value(out, field_text(*fields[n]));
+                } else {
+                    append_scalar(out, *fields[n], false);
+                }
+            }
+            out += '\n';
+            break;
+
+        case StructuredFormat::Text:
+        default:
+            if (timestamp_ms >= 0) {
+                append_int(out, timestamp_ms);
+                out += ' ';
+            }
+            out += message;
+            for (std::size_t n = 0; n < count; ++n) {
+                out += ' ';
+                append_logfmt_key(out, fields[n]->key);
+                out += '=';
+                if (is_text_field(*fields[n])) {
+                    append_logfmt_value(out, field_text(*fields[n]));
+                } else {
+                    append_scalar(out, *fields[n], false);
+                }
+            }
+            out += '\n';
+            break;
+    }
+}
+
+/**
+ * @brief ヒストグラムのスナップショット（集計済みの値）
+ *
+ * バケット i は [2^(i-1), 2^i) の範囲を表す（バケット 0 は値 0）。
+ */
+struct HistogramData {
+    static constexpr std::size_t kBuckets = 65;
+
+    std::array<std::uint64_t, kBuckets> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    void merge(const HistogramData& other) {
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+
+    double mean() const {
+        return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+    }
+
+    // 分位点の近似値（該当バケットの上限、ただし最大値で頭打ち）
+    std::uint64_t percentile(double q) const {
+        if (count == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                std::uint64_t upper = i == 0 ? 0 : (i >= 64 ? UINT64_MAX : (std::uint64_t{1} << i) - 1);
+                return std::min(upper, max);
+            }
+        }
+        return max;
+    }
+
+    void append_json(std::string& out) const {
+        out += "{\"count\":" + std::to_string(count);
+        out += ",\"sum\":" + std::to_string(sum);
+        out += ",\"max\":" + std::to_string(max);
+        out += ",\"p50\":" + std::to_string(percentile(0.50));
+        out += ",\"p90\":" + std::to_string(percentile(0.90));
+        out += ",\"p99\":" + std::to_string(percentile(0.99));
+        out += ",\"buckets\":{";
+        bool first = true;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            if (buckets[i] == 0) continue;
+            if (!first) out += ',';
+            first = false;
+            // キーはバケットの上限値
+            std::uint64_t upper = i == 0 ? 0 : (i >= 64 ? UINT64_MAX : (std::uint64_t{1} << i) - 1);
+            out += '"' + std::to_string(upper) + "\":" + std::to_string(buckets[i]);
+        }
+        out += "}}";
+    }
+};
+
+/**
+ * @brief ロックフリーな対数バケットのヒストグラム
+ */
+class LatencyHistogram {
+public:
+    void record(std::uint64_t value) {
+        buckets_[bit_width64(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        auto prev = max_.load(std::memory_order_relaxed);
+        while (value > prev &&
+               !max_.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void collect(HistogramData& out) const {
+        HistogramData data;
+        for (std::size_t i = 0; i < HistogramData::kBuckets; ++i) {
+            data.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+        data.count = count_.load(std::memory_order_relaxed);
+        data.sum = sum_.load(std::memory_order_relaxed);
+        data.max = max_.load(std::memory_order_relaxed);
+        out.merge(data);
+    }
+
+    void reset() {
+        for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, HistogramData::kBuckets> buckets_{};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+// スレッドごとに固定されるシャード番号
+inline std::size_t this_thread_shard(std::size_t shard_count) {
+    static std::atomic<std::size_t> next_index{0};
+    thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index % shard_count;
+}
+
+/**
+ * @brief Logger の実行時メトリクス
+ *
+ * カウンタはスレッドごとのシャード（キャッシュライン分離）に加算し、
+ * 読み取り時に全シャードを集計する。書き込み側は relaxed な加算のみ。
+ */
+class LoggerMetrics {
+public:
+    static constexpr std::size_t kShards = 16;
+
+    struct alignas(64) Shard {
+        std::atomic<std::uint64_t> records{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> flushes{0};
+        std::atomic<std::uint64_t> file_opens{0};
+        std::atomic<std::uint64_t> file_closes{0};
+        std::atomic<std::uint64_t> watcher_events{0};
+        std::atomic<std::uint64_t> input_reparses{0};
+        std::atomic<std::uint64_t> sampled_out{0};
+        std::atomic<std::uint64_t> deduplicated{0};
+        LatencyHistogram lock_wait_ns;
+    };
+
+    Shard& local() {
+        return shards_[this_thread_shard(kShards)];
+    }
+
+    static void add(std::atomic<std::uint64_t>& counter, std::uint64_t n = 1) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    template<typename Fn>
+    void for_each_shard(Fn&& fn) const {
+        for (const auto& shard : shards_) fn(shard);
+    }
+
+    void reset() {
+        for (auto& shard : shards_) {
+            shard.records.store(0, std::memory_order_relaxed);
+            shard.bytes.store(0, std::memory_order_relaxed);
+            shard.flushes.store(0, std::memory_order_relaxed);
+            shard.file_opens.store(0, std::memory_order_relaxed);
+            shard.file_closes.store(0, std::memory_order_relaxed);
+            shard.watcher_events.store(0, std::memory_order_relaxed);
+            shard.input_reparses.store(0, std::memory_order_relaxed);
+            shard.sampled_out.store(0, std::memory_order_relaxed);
+            shard.deduplicated.store(0, std::memory_order_relaxed);
+            shard.lock_wait_ns.reset();
+        }
+    }
+
+private:
+    std::array<Shard, kShards> shards_;
+};
+
+// ============================================================
+// ロック競合プロファイラ
+// ============================================================
+
+// mtx_ を取得する呼び出し箇所
+enum class LockSite : std::size_t {
+    Log,           // log / log_formatted
+    LogTo,         // log_to / write_atomic
+    Flush,         // flush
+    LockedStream,  // get_locked_stream の保持期間
+    Config,        // 設定の読み書き（パス・モード等）
+    Other,         // close_all / reset / メトリクス取得など
+    Count
+};
+
+inline const char* lock_site_name(LockSite site) {
+    switch (site) {
+        case LockSite::Log: return "log";
+        case LockSite::LogTo: return "log_to";
+        case LockSite::Flush: return "flush";
+        case LockSite::LockedStream: return "locked_stream";
+        case LockSite::Config: return "config";
+        case LockSite::Other: return "other";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief 呼び出し箇所ごとのロック待ち時間・保持時間のヒストグラム
+ *
+ * 計測自体が競合を増やさないよう、スレッドごとのシャードに記録する。
+ */
+class LockProfiler {
+public:
+    static constexpr std::size_t kSites = static_cast<std::size_t>(LockSite::Count);
+    static constexpr std::size_t kShards = 8;
+
+    struct SiteStats {
+        LatencyHistogram wait_ns;
+        LatencyHistogram hold_ns;
+    };
+
+    SiteStats& local(LockSite site) {
+        return shards_[this_thread_shard(kShards)].sites[static_cast<std::size_t>(site)];
+    }
+
+    void collect(LockSite site, HistogramData& wait, HistogramData& hold) const {
+        for (const auto& shard : shards_) {
+            const auto& stats = shard.sites[static_cast<std::size_t>(site)];
+            stats.wait_ns.collect(wait);
+            stats.hold_ns.collect(hold);
+        }
+    }
+
+    void reset() {
+        for (auto& shard : shards_) {
+            for (auto& stats : shard.sites) {
+                stats.wait_ns.reset();
+                stats.hold_ns.reset();
+            }
+        }
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<SiteStats, kSites> sites;
+    };
+    std::array<Shard, kShards> shards_;
+};
+
+/**
+ * @brief 保持時間を計測できる unique_lock のラッパー
+ *
+ * プロファイル無効時は std::unique_lock と同じ振る舞いをする。
+ */
+class ProfiledLock {
+public:
+    ProfiledLock() = default;
+
+    explicit ProfiledLock(std::unique_lock<std::mutex> lock)
+        : lock_(std::move(lock)) {}
+
+    ProfiledLock(std::unique_lock<std::mutex> lock, LockProfiler::SiteStats* stats,
+                 std::chrono::steady_clock::time_point acquired)
+        : lock_(std::move(lock)), stats_(stats), acquired_(acquired) {}
+
+    ProfiledLock(ProfiledLock&& other) noexcept
+        : lock_(std::move(other.lock_)), stats_(other.stats_), acquired_(other.acquired_) {
+        other.stats_ = nullptr;
+    }
+
+    ProfiledLock& operator=(ProfiledLock&& other) noexcept {
+        if (this != &other) {
+            unlock();
+            lock_ = std::move(other.lock_);
+            stats_ = other.stats_;
+            acquired_ = other.acquired_;
+            other.stats_ = nullptr;
+        }
+        return *this;
+    }
+
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    ~ProfiledLock() {
+        unlock();
+    }
+
+    void unlock() {
+        if (lock_.owns_lock()) {
+            if (stats_) {
+                auto held = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - acquired_).count();
+                stats_->hold_ns.record(static_cast<std::uint64_t>(held));
+            }
+            lock_.unlock();
+        }
+        stats_ = nullptr;
+    }
+
+    bool owns_lock() const {
+        return lock_.owns_lock();
+    }
+
+private:
+    std::unique_lock<std::mutex> lock_;
+    LockProfiler::SiteStats* stats_ = nullptr;
+    std::chrono::steady_clock::time_point acquired_{};
+};
+
+// ============================================================
+// 出力先（シンク）
+// ============================================================
+
+/**
+ * @brief ファイルの代わりにレコードを受け取る出力先
+ *
+ * Logger::set_sink() で登録したパスへの書き込みは std::ofstream ではなくシンクに渡される。
+ * 呼び出しは常にロガーのミューテックスを保持した状態で行われる。
+ * 破棄時に未出力のデータを書き出してファイルを完結させること（close_all で破棄される）。
+ */
+class LogSink {
+public:
+    virtual ~LogSink() = default;
+
+    // 1レコード分のデータ（LockedStream の内容は終了時にまとめて渡す）
+    virtual void write(std::string_view data) = 0;
+
+    // flush() 呼び出し時。ここまでのデータを読み出せる状態にする
+    virtual void flush() = 0;
+};
+
+// LockedStream からシンクへ書き込むための streambuf
+// 断片はためておき、LockedStream の終了時（commit）に1レコードとしてシンクに渡す
+class SinkStreambuf : public std::streambuf {
+public:
+    explicit SinkStreambuf(LogSink& sink) : sink_(sink) {}
+
+    void commit() {
+        if (!pending_.empty()) {
+            sink_.write(pending_);
+            pending_.clear();
+        }
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            pending_ += traits_type::to_char_type(ch);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        pending_.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+    int sync() override {
+        commit();
+        sink_.flush();
+        return 0;
+    }
+
+private:
+    LogSink& sink_;
+    std::string pending_;
+};
+
+class SinkStream : public std::ostream {
+public:
+    explicit SinkStream(LogSink& sink) : std::ostream(nullptr), buf_(sink) {
+        rdbuf(&buf_);
+    }
+
+    void commit() {
+        buf_.commit();
+    }
+
+private:
+    SinkStreambuf buf_;
+};
+
+// 書き込みを捨てるシンク（Logger::set_muted で使う）
+class DiscardSink : public LogSink {
+public:
+    void write(std::string_view) override {}
+    void flush() override {}
+};
+
+/**
+ * @brief 複数プロセスで共有するファイルへの追記の設定
+ */
+struct SharedAppendOptions {
+    // この長さまでのレコードはロックを取らず 1 回の O_APPEND write で書く
+    std::size_t atomic_write_max = 4096;
+};
+
+/**
+ * @brief 複数プロセスから同じファイルに追記するためのシンク
+ *
+ * 各レコードを O_APPEND で開いたファイルへの 1 回の write で書く。
+ * ローカルファイルシステムでは、1 回の追記 write は他プロセスの追記と混ざらない。
+ * atomic_write_max を超えるレコードは、write が分割されても途中に他のレコードが
+ * 入らないよう、ファイルの排他アドバイザリロック（flock / LockFileEx）を取って書く。
+ * 書き込みはカーネルに直接渡すため、flush() は何もしない。
+ */
+class SharedAppendSink : public LogSink {
+public:
+    SharedAppendSink(const std::string& path, const SharedAppendOptions& options)
+        : atomic_write_max_(options.atomic_write_max) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+#else
+        fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+#endif
+    }
+
+    ~SharedAppendSink() override {
+#ifdef _WIN32
+        CloseHandle(file_);
+#else
+        ::close(fd_);
+#endif
+    }
+
+    SharedAppendSink(const SharedAppendSink&) = delete;
+    SharedAppendSink& operator=(const SharedAppendSink&) = delete;
+
+    void write(std::string_view data) override {
+        if (data.size() <= atomic_write_max_) {
+            write_all(data);
+            return;
+        }
+        lock_file();
+        write_all(data);
+        unlock_file();
+    }
+
+    void flush() override {}
+
+private:
+#ifdef _WIN32
+    // 実データと重ならない末尾近くの 1 バイトをプロセス間ミューテックスとして使う
+    void lock_file() {
+        OVERLAPPED ov{};
+        ov.Offset = 0xFFFFFFFEu;
+        ov.OffsetHigh = 0x7FFFFFFFu;
+        LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+    }
+
+    void unlock_file() {
+        OVERLAPPED ov{};
+        ov.Offset = 0xFFFFFFFEu;
+        ov.OffsetHigh = 0x7FFFFFFFu;
+        UnlockFileEx(file_, 0, 1, 0, &ov);
+    }
+
+    void write_all(std::string_view data) {
+        while (!data.empty()) {
+            DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(data.size(), 0x40000000u));
+            DWORD written = 0;
+            if (!WriteFile(file_, data.data(), chunk, &written, nullptr)) {
+                throw std::runtime_error("WriteFile failed");
+            }
+            data.remove_prefix(written);
+        }
+    }
+
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+    void lock_file() {
+        while (::flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+        }
+    }
+
+    void unlock_file() {
+        ::flock(fd_, LOCK_UN);
+    }
+
+    void write_all(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t written = ::write(fd_, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+    }
+
+    int fd_ = -1;
+#endif
+    std::size_t atomic_write_max_;
+};
+
+/**
+ * @brief ページキャッシュを通さないファイル出力の設定
+ */
+struct DirectIOOptions {
+    std::size_t block_size = 4096;                      // 書き込みの境界（デバイスの論理ブロックサイズの倍数）
+    std::size_t buffer_bytes = 256 * 1024;              // 1 回に書く量（block_size の倍数に切り上げる）
+    std::size_t buffer_count = 4;                       // バッファプールの数（2 以上）
+    std::size_t preallocate_bytes = 16 * 1024 * 1024;   // fallocate で先に確保する単位（0 で確保しない）
+};
+
+#ifndef _WIN32
+/**
+ * @brief O_DIRECT でファイルに書くシンク
+ *
+ * レコードはアラインしたバッファにためて、満杯になったバッファを書き込みスレッドが
+ * buffer_bytes 単位の O_DIRECT pwrite で書く（macOS では F_NOCACHE）。書き込む範囲は
+ * fallocate(FALLOC_FL_KEEP_SIZE) で preallocate_bytes ずつ先に確保する（Linux）。
+ * flush() と破棄時は末尾の端数ブロックを 0 で埋めて書き、ファイルサイズを
+ * 書いたバイト数に ftruncate で戻す。端数ブロックはバッファに残し、次の書き込みで上書きする。
+ * O_DIRECT を使えないファイルシステム（tmpfs など）では通常の書き込みになる。
+ */
+class DirectFileSink : public LogSink {
+public:
+    DirectFileSink(const std::string& path, const DirectIOOptions& options)
+        : block_size_(std::max<std::size_t>(options.block_size, 512)),
+          preallocate_bytes_(options.preallocate_bytes) {
+        if ((block_size_ & (block_size_ - 1)) != 0) {
+            throw std::runtime_error("direct I/O block size must be a power of two");
+        }
+        buffer_bytes_ = round_up(std::max(options.buffer_bytes, block_size_));
+        std::size_t count = std::max<std::size_t>(options.buffer_count, 2);
+        for (std::size_t i = 0; i < count; ++i) {
+            pool_.push_back(std::make_unique<Block>(block_size_, buffer_bytes_));
+        }
+        for (std::size_t i = 1; i < count; ++i) {
+            free_.push_back(pool_[i].get());
+        }
+        current_ = pool_[0].get();
+
+        int flags = O_RDWR | O_CREAT | O_CLOEXEC;
+#ifdef O_DIRECT
+        fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+#endif
+        if (fd_ < 0) {
+            fd_ = ::open(path.c_str(), flags, 0644);
+        }
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+#ifdef F_NOCACHE
+        direct_ = ::fcntl(fd_, F_NOCACHE, 1) == 0;
+#endif
+
+        // 既存ファイルの末尾の端数ブロックは読み込んで続きから書く
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("fstat failed: " + path);
+        }
+        size_ = static_cast<std::uint64_t>(st.st_size);
+        current_->offset = size_ - size_ % block_size_;
+        current_->fill = static_cast<std::size_t>(size_ - current_->offset);
+        if (current_->fill > 0 &&
+            ::pread(fd_, current_->data, block_size_, static_cast<off_t>(current_->offset)) < static_cast<ssize_t>(current_->fill)) {
+            ::close(fd_);
+            throw std::runtime_error("failed to read the tail of " + path);
+        }
+        allocated_end_ = round_up(size_);
+        writer_ = std::thread([this] { run(); });
+    }
+
+    ~DirectFileSink() override {
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            std::cerr << "[logfunc] Warning: " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+        ::close(fd_);
+    }
+
+    DirectFileSink(const DirectFileSink&) = delete;
+    DirectFileSink& operator=(const DirectFileSink&) = delete;
+
+    bool is_direct() const {
+        return direct_;
+    }
+
+    void write(std::string_view data) override {
+        while (!data.empty()) {
+            std::size_t n = std::min(data.size(), buffer_bytes_ - current_->fill);
+            std::memcpy(current_->data + current_->fill, data.data(), n);
+            current_->fill += n;
+            size_ += n;
+            data.remove_prefix(n);
+            if (current_->fill == buffer_bytes_) {
+                submit_current();
+            }
+        }
+    }
+
+    void flush() override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return (full_.empty() && !writing_) || !error_.empty(); });
+        throw_if_failed();
+        if (current_->fill == 0) {
+            return;
+        }
+        // 書き込みスレッドは止まっているので、ここで端数ブロックを書く
+        std::size_t length = static_cast<std::size_t>(round_up(current_->fill));
+        std::memset(current_->data + current_->fill, 0, length - current_->fill);
+        write_block(current_->data, length, current_->offset);
+        if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+            throw std::runtime_error(std::string("ftruncate failed: ") + std::strerror(errno));
+        }
+        // EOF より後ろの確保済み領域は ftruncate で解放される
+        allocated_end_ = round_up(size_);
+    }
+
+private:
+    // block_size 境界にそろえたバッファ 1 つと、その書き込み先
+    struct Block {
+        Block(std::size_t alignment, std::size_t size) {
+            void* p = nullptr;
+            if (::posix_memalign(&p, alignment, size) != 0) {
+                throw std::bad_alloc();
+            }
+            data = static_cast<char*>(p);
+        }
+        ~Block() {
+            std::free(data);
+        }
+        Block(const Block&) = delete;
+        Block& operator=(const Block&) = delete;
+
+        char* data = nullptr;
+        std::size_t fill = 0;
+        std::uint64_t offset = 0;
+    };
+
+    std::uint64_t round_up(std::uint64_t n) const {
+        return (n + block_size_ - 1) & ~static_cast<std::uint64_t>(block_size_ - 1);
+    }
+
+    void throw_if_failed() const {
+        if (!error_.empty()) {
+            throw std::runtime_error(error_);
+        }
+    }
+
+    // 満杯のバッファを書き込みスレッドに渡し、空きバッファを受け取る
+    void submit_current() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        std::uint64_t next_offset = current_->offset + buffer_bytes_;
+        full_.push_back(current_);
+        cv_.notify_all();
+        cv_.wait(lock, [&] { return !free_.empty() || !error_.empty(); });
+        throw_if_failed();
+        current_ = free_.back();
+        free_.pop_back();
+        current_->fill = 0;
+        current_->offset = next_offset;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true) {
+            cv_.wait(lock, [&] { return stop_ || !full_.empty(); });
+            if (full_.empty()) {
+                break;
+            }
+            Block* block = full_.front();
+            full_.pop_front();
+            writing_ = true;
+            lock.unlock();
+
+            std::string error;
+            try {
+                write_block(block->data, buffer_bytes_, block->offset);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+
+            lock.lock();
+            writing_ = false;
+            if (!error.empty() && error_.empty()) {
+                error_ = std::move(error);
+            }
+            free_.push_back(block);
+            cv_.notify_all();
+        }
+    }
+
+    void write_block(const char* data, std::size_t length, std::uint64_t offset) {
+        preallocate(offset + length);
+        while (length > 0) {
+            ssize_t written = ::pwrite(fd_, data, length, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("direct write failed: ") + std::strerror(errno));
+            }
+            data += written;
+            length -= static_cast<std::size_t>(written);
+            offset += static_cast<std::uint64_t>(written);
+        }
+    }
+
+    // end までの領域を preallocate_bytes 単位で先に確保する（ファイルサイズは変えない）
+    void preallocate(std::uint64_t end) {
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+        if (preallocate_bytes_ == 0 || end <= allocated_end_) {
+            return;
+        }
+        std::uint64_t length = round_up(std::max<std::uint64_t>(end - allocated_end_, preallocate_bytes_));
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated_end_), static_cast<off_t>(length)) == 0) {
+            allocated_end_ += length;
+        } else {
+            preallocate_bytes_ = 0;  // 対応していないファイルシステムでは諦める
+        }
+#else
+        (void)end;
+#endif
+    }
+
+    int fd_ = -1;
+    bool direct_ = false;
+    std::size_t block_size_;
+    std::size_t buffer_bytes_ = 0;
+    std::size_t preallocate_bytes_;
+    std::uint64_t size_ = 0;            // 書いたバイト数（ファイルの論理サイズ）
+    std::uint64_t allocated_end_ = 0;   // fallocate で確保済みの終端
+
+    std::vector<std::unique_ptr<Block>> pool_;
+    Block* current_ = nullptr;          // 書き込み側が埋めているバッファ
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Block*> full_;
+    std::vector<Block*> free_;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::string error_;
+    std::thread writer_;
+};
+#endif
+
+// ============================================================
+// 永続性（fdatasync のグループコミット）
+// ============================================================
+
+/**
+ * @brief パスごとの永続性のレベル
+ */
+enum class Durability {
+    None,       // バッファに残してよい（flush() / close_all() で OS に渡す）
+    Flush,      // レコードごとに OS に渡す（デフォルト）
+    GroupSync   // OS に渡したうえで、window ごとにまとめて fdatasync する
+};
+
+/**
+ * @brief 永続性の設定
+ */
+struct DurabilityPolicy {
+    Durability level = Durability::Flush;
+    // GroupSync: 最初の未同期レコードから同期までの待ち時間。0 ならすぐ同期し、
+    // 同期中に届いたレコードは次の 1 回にまとめる
+    std::chrono::microseconds window{0};
+};
+
+/**
+ * @brief 1 つのファイルの fdatasync をまとめて行う
+ *
+ * 書き込みごとに番号を振り、同期スレッドが window の間（と前回の同期中）に届いた
+ * レコードを 1 回の fdatasync（Windows では FlushFileBuffers）で同期する。
+ * 同期にはファイルを別に開いた記述子を使う（同期はファイル単位で効く）。
+ * note_write() の前にデータを OS に渡しておくこと。同期に失敗した番号までは失敗として扱う。
+ */
+class GroupCommitter {
+public:
+    GroupCommitter(const std::string& path, std::chrono::microseconds window) : window_(window) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file for sync: " + path);
+        }
+#else
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open file for sync: " + path);
+        }
+#endif
+        syncer_ = std::thread([this] { run(); });
+    }
+
+    ~GroupCommitter() {
+        close();
+#ifdef _WIN32
+        CloseHandle(file_);
+#else
+        ::close(fd_);
+#endif
+    }
+
+    GroupCommitter(const GroupCommitter&) = delete;
+    GroupCommitter& operator=(const GroupCommitter&) = delete;
+
+    // ここまでに OS に渡したデータを同期の対象にし、その番号を返す
+    std::uint64_t note_write() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++written_;
+        if (syncer_idle_) {
+            cv_.notify_one();
+        }
+        return written_;
+    }
+
+    // seq までの同期を timeout まで待つ。同期できた場合だけ true（失敗・タイムアウトは false）
+    bool wait(std::uint64_t seq, std::chrono::milliseconds timeout = std::chrono::milliseconds::max()) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto done = [&] { return synced_ >= seq || stop_; };
+        if (timeout == std::chrono::milliseconds::max()) {
+            done_cv_.wait(lock, done);
+        } else if (!done_cv_.wait_for(lock, timeout, done)) {
+            return false;
+        }
+        return synced_ >= seq && seq > failed_;
+    }
+
+    // seq までの同期が終わったか（失敗した場合も true）
+    bool is_synced(std::uint64_t seq) const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return synced_ >= seq;
+    }
+
+    bool is_failed(std::uint64_t seq) const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return seq <= failed_;
+    }
+
+    std::uint64_t sync_count() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return syncs_;
+    }
+
+    // 残りを同期して同期スレッドを止める（ハンドルを閉じるとき）
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (stop_) return;
+            stop_ = true;
+        }
+        cv_.notify_all();
+        syncer_.join();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true) {
+            syncer_idle_ = true;
+            cv_.wait(lock, [&] { return stop_ || written_ > synced_; });
+            syncer_idle_ = false;
+            if (written_ == synced_) {
+                break;
+            }
+            // window の間に届いたレコードを同じ同期に含める
+            if (!stop_ && window_.count() > 0) {
+                cv_.wait_for(lock, window_, [&] { return stop_; });
+            }
+            std::uint64_t target = written_;
+            lock.unlock();
+            bool ok = sync_file();
+            lock.lock();
+            if (!ok) {
+                // エラーは一度しか報告されないので、以後の成功でもこの範囲は取り戻せない
+                failed_ = target;
+                std::cerr << "[logfunc] Warning: fdatasync failed: " << last_error_ << std::endl;
+            }
+            synced_ = target;
+            ++syncs_;
+            done_cv_.notify_all();
+        }
+        done_cv_.notify_all();
+    }
+
+    bool sync_file() {
+#ifdef _WIN32
+        if (!FlushFileBuffers(file_)) {
+            last_error_ = "error " + std::to_string(GetLastError());
+            return false;
+        }
+#else
+        int result;
+#ifdef __APPLE__
+        while ((result = ::fsync(fd_)) != 0 && errno == EINTR) {
+        }
+#else
+        while ((result = ::fdatasync(fd_)) != 0 && errno == EINTR) {
+        }
+#endif
+        if (result != 0) {
+            last_error_ = std::strerror(errno);
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    std::chrono::microseconds window_;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;        // 同期スレッドを起こす
+    std::condition_variable done_cv_;   // 待っている呼び出し側を起こす
+    std::uint64_t written_ = 0;
+    std::uint64_t synced_ = 0;
+    std::uint64_t failed_ = 0;          // 同期に失敗した最大の番号
+    std::uint64_t syncs_ = 0;
+    std::string last_error_;            // 同期スレッドだけが書く
+    bool syncer_idle_ = false;
+    bool stop_ = false;
+    std::thread syncer_;
+};
+
+/**
+ * @brief グループコミットの完了を待つためのチケット
+ *
+ * Logger::commit_ticket() で受け取る。GroupSync でないパスのチケットは最初から完了している。
+ */
+class CommitTicket {
+public:
+    CommitTicket() = default;
+    CommitTicket(std::shared_ptr<GroupCommitter> committer, std::uint64_t seq)
+        : committer_(std::move(committer)), seq_(seq) {}
+
+    // 同期が終わるまで待つ（Logger が閉じられた場合も残りを同期してから戻る）
+    // fdatasync が失敗した場合は false
+    bool wait() const {
+        return !committer_ || committer_->wait(seq_);
+    }
+
+    bool wait_for(std::chrono::milliseconds timeout) const {
+        return !committer_ || committer_->wait(seq_, timeout);
+    }
+
+    // 同期が終わったか（失敗した場合も true。結果は failed() で確認する）
+    bool done() const {
+        return !committer_ || committer_->is_synced(seq_);
+    }
+
+    bool failed() const {
+        return committer_ && committer_->is_failed(seq_);
+    }
+
+private:
+    std::shared_ptr<GroupCommitter> committer_;
+    std::uint64_t seq_ = 0;
+};
+
+// ============================================================
+// 共有バックエンド（複数の Logger で 1 つのファイル表と書き込みスレッドを使う）
+// ============================================================
+
+/**
+ * @brief 共有バックエンドの設定
+ */
+struct SharedBackendOptions {
+    // 書き込み待ちがこの量を超えると、書き込み側は書き込みスレッドが追いつくまで待つ
+    std::size_t max_pending_bytes = 8 * 1024 * 1024;
+};
+
+/**
+ * @brief 複数の Logger が共有するファイル表と書き込みスレッド
+ *
+ * ファイルは実体（POSIX ではデバイスと inode、Windows ではボリュームとファイル番号）で
+ * 重複を除き、同じファイルを指すパスは別の Logger から開いても 1 つの記述子を使う。
+ * レコードはファイルごとのバッファに追記し、1 本の書き込みスレッドがたまった分を
+ * ファイルごとに 1 回の write で書く。レコードはバッファに丸ごと追記するため、
+ * 複数の Logger が同じファイルに書いても行は混ざらない。
+ */
+class SharedBackend {
+public:
+    /**
+     * @brief バックエンドが開いている 1 つのファイル
+     */
+    class File {
+    public:
+        ~File() {
+#ifdef _WIN32
+            CloseHandle(handle_);
+#else
+            ::close(fd_);
+#endif
+        }
+
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        const std::string& path() const {
+            return path_;
+        }
+
+    private:
+        friend class SharedBackend;
+        File() = default;
+
+        std::string path_;
+        std::string key_;
+#ifdef _WIN32
+        HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+        int fd_ = -1;
+#endif
+        // 以下は SharedBackend::mtx_ で保護する
+        std::string pending_;            // 書き込み待ちのレコード
+        bool queued_ = false;            // dirty_ に入っているか
+        std::uint64_t appended_ = 0;     // 追記したバイト数の累計
+        std::uint64_t written_ = 0;      // 書き終えた（または失敗して捨てた）バイト数の累計
+        bool failed_ = false;            // 書き込み失敗を報告済みか
+        std::string writing_;            // 書き込みスレッドだけが使う
+    };
+
+    explicit SharedBackend(SharedBackendOptions options = {}) : options_(options) {
+        writer_ = std::thread([this] { run(); });
+    }
+
+    ~SharedBackend() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        writer_.join();
+    }
+
+    SharedBackend(const SharedBackend&) = delete;
+    SharedBackend& operator=(const SharedBackend&) = delete;
+
+    /**
+     * @brief プロセスで 1 つの共有バックエンド
+     *
+     * 開いているファイルが参照を持つため、静的破棄の後に閉じられる Logger からも使える。
+     */
+    static std::shared_ptr<SharedBackend> instance() {
+        static std::shared_ptr<SharedBackend> backend = std::make_shared<SharedBackend>();
+        return backend;
+    }
+
+    /**
+     * @brief path を追記用に開く（同じファイルを開いていればそれを返す）
+     */
+    std::shared_ptr<File> open(const std::string& path) {
+        std::shared_ptr<File> file(new File());
+        file->path_ = path;
+#ifdef _WIN32
+        file->handle_ = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        BY_HANDLE_FILE_INFORMATION info{};
+        if (file->handle_ == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(file->handle_, &info)) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        file->key_ = std::to_string(info.dwVolumeSerialNumber) + ':' +
+                     std::to_string((static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow);
+#else
+        file->fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st{};
+        if (file->fd_ < 0 || ::fstat(file->fd_, &st) != 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        file->key_ = std::to_string(static_cast<std::uint64_t>(st.st_dev)) + ':' +
+                     std::to_string(static_cast<std::uint64_t>(st.st_ino));
+#endif
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto& entry = files_[file->key_];
+        if (auto existing = entry.lock()) {
+            return existing;  // 新しく開いた記述子は file と一緒に閉じる
+        }
+        entry = file;
+        // 閉じられたファイルの項目を掃除する
+        for (auto it = files_.begin(); it != files_.end();) {
+            it = it->second.expired() ? files_.erase(it) : std::next(it);
+        }
+        return file;
+    }
+
+    /**
+     * @brief 1 レコードを file の書き込み待ちに追記する
+     */
+    void submit(const std::shared_ptr<File>& file, std::string_view data) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (pending_bytes_ > 0 && pending_bytes_ + data.size() > options_.max_pending_bytes) {
+            space_cv_.wait(lock, [&] { return pending_bytes_ + data.size() <= options_.max_pending_bytes || pending_bytes_ == 0; });
+        }
+        file->pending_.append(data.data(), data.size());
+        file->appended_ += data.size();
+        pending_bytes_ += data.size();
+        if (!file->queued_) {
+            file->queued_ = true;
+            dirty_.push_back(file);
+            if (dirty_.size() == 1) {
+                work_cv_.notify_one();
+            }
+        }
+    }
+
+    /**
+     * @brief file にここまで追記した分が書き終わるまで待つ
+     */
+    void flush(const File& file) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        std::uint64_t target = file.appended_;
+        space_cv_.wait(lock, [&] { return file.written_ >= target; });
+    }
+
+    /**
+     * @brief 開いているファイルの数
+     */
+    std::size_t file_count() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::size_t count = 0;
+        for (const auto& [key, file] : files_) {
+            count += file.expired() ? 0 : 1;
+        }
+        return count;
+    }
+
+    /**
+     * @brief 書き込みスレッドが発行した write の回数
+     */
+    std::uint64_t write_calls() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return write_calls_;
+    }
+
+private:
+    void run() {
+        std::vector<std::shared_ptr<File>> batch;
+        std::vector<std::uint64_t> targets;
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true) {
+            work_cv_.wait(lock, [&] { return stop_ || !dirty_.empty(); });
+            if (dirty_.empty()) {
+                break;
+            }
+            batch.swap(dirty_);
+            targets.clear();
+            for (auto& file : batch) {
+                file->writing_.swap(file->pending_);
+                file->queued_ = false;
+                targets.push_back(file->appended_);
+            }
+            pending_bytes_ = 0;
+            space_cv_.notify_all();
+            lock.unlock();
+
+            std::uint64_t calls = 0;
+            for (auto& file : batch) {
+                calls += write_file(*file);
+            }
+
+            lock.lock();
+            write_calls_ += calls;
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                batch[i]->written_ = targets[i];
+            }
+            // flush() から戻った時点で閉じたファイルが表に残らないよう、参照は通知の前に手放す
+            batch.clear();
+            space_cv_.notify_all();
+        }
+    }
+
+    // writing_ の内容を書き、write の回数を返す。失敗したら最初の 1 回だけ警告して捨てる
+    std::uint64_t write_file(File& file) {
+        std::string_view data = file.writing_;
+        std::uint64_t calls = 0;
+        while (!data.empty()) {
+            ++calls;
+#ifdef _WIN32
+            DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(data.size(), 0x40000000u));
+            DWORD written = 0;
+            if (!WriteFile(file.handle_, data.data(), chunk, &written, nullptr)) {
+                report_failure(file, "WriteFile failed");
+                break;
+            }
+#else
+            ssize_t written = ::write(file.fd_, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                report_failure(file, std::strerror(errno));
+                break;
+            }
+#endif
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+        file.writing_.clear();
+        return calls;
+    }
+
+    void report_failure(File& file, const std::string& reason) {
+        if (!file.failed_) {
+            file.failed_ = true;
+            std::cerr << "[logfunc] Warning: shared backend failed to write " << file.path_
+                      << ": " << reason << std::endl;
+        }
+    }
+
+    SharedBackendOptions options_;
+    mutable std::mutex mtx_;
+    std::condition_variable work_cv_;    // 書き込みスレッドを起こす
+    std::condition_variable space_cv_;   // 書き込み待ちの減少・書き込みの完了を知らせる
+    std::unordered_map<std::string, std::weak_ptr<File>> files_;  // 実体のキー → ファイル
+    std::vector<std::shared_ptr<File>> dirty_;                     // 書き込み待ちのあるファイル
+    std::size_t pending_bytes_ = 0;
+    std::uint64_t write_calls_ = 0;
+    bool stop_ = false;
+    std::thread writer_;
+};
+
+/**
+ * @brief 共有バックエンドに書くシンク（Logger::attach_backend で使う）
+ */
+class BackendSink : public LogSink {
+public:
+    BackendSink(std::shared_ptr<SharedBackend> backend, const std::string& path)
+        : backend_(std::move(backend)), file_(backend_->open(path)) {}
+
+    // 閉じるときは書き込み待ちを書き終えてから戻る
+    ~BackendSink() override {
+        backend_->flush(*file_);
+    }
+
+    BackendSink(const BackendSink&) = delete;
+    BackendSink& operator=(const BackendSink&) = delete;
+
+    void write(std::string_view data) override {
+        backend_->submit(file_, data);
+    }
+
+    void flush() override {
+        backend_->flush(*file_);
+    }
+
+private:
+    std::shared_ptr<SharedBackend> backend_;
+    std::shared_ptr<SharedBackend::File> file_;
+};
+
+// ============================================================
+// フライトレコーダー（メモリ上のリングバッファ）
+// ============================================================
+
+/**
+ * @brief フライトレコーダーの設定
+ */
+struct FlightRecorderOptions {
+    std::size_t capacity = 4096;                   // 保持するレコード数
+    std::string trigger;                           // この文字列を含むレコードで自動ダンプ（空なら無効）
+    std::string dump_path;                         // 自動ダンプの出力先（空なら各レコードの元の出力先）
+    std::size_t dump_records = 0;                  // 自動ダンプする件数（0 なら全件）
+};
+
+/**
+ * @brief リングから取り出した1レコード
+ */
+struct FlightRecord {
+    std::string path;  // 元の出力先（空ならデフォルトのログファイル）
+    std::string text;
+};
+
+/**
+ * @brief 直近のレコードを固定数だけ保持するリングバッファ（古いものから上書き）
+ *
+ * 書き込み側は通し番号の fetch_add とスロット単位のスピンロックだけで、
+ * ファイル I/O もロガーのミューテックスも使わない。スロットの文字列は容量を
+ * 使い回すため、定常状態ではヒープ確保も発生しない。
+ */
+class FlightRecorder {
+public:
+    explicit FlightRecorder(FlightRecorderOptions options)
+        : options_(std::move(options)),
+          capacity_(options_.capacity > 0 ? options_.capacity : 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {}
+
+    // 構築後は変更しないため、書き込み側からロックなしで参照できる
+    const FlightRecorderOptions& options() const {
+        return options_;
+    }
+
+    // path が空ならデフォルトのログファイル宛て
+    void record(std::string_view path, std::string_view content) {
+        std::uint64_t seq = next_.fetch_add(1, std::memory_order_relaxed) + 1;  // 0 は空きスロット
+        Slot& slot = slots_[seq % capacity_];
+        slot.lock();
+        // 一周遅れの書き込みが新しいレコードを上書きしないようにする
+        if (seq > slot.seq) {
+            slot.seq = seq;
+            slot.path.assign(path.data(), path.size());
+            slot.text.assign(content.data(), content.size());
+        }
+        slot.unlock();
+    }
+
+    /**
+     * @brief レコードを古い順に取り出し、取り出したレコードだけを消去する
+     *
+     * max_records で絞った場合、それより古いレコードはリングに残り、次の drain で取り出せる。
+     *
+     * @param max_records 新しい方から数えた最大件数（0 なら全件）
+     */
+    std::vector<FlightRecord> drain(std::size_t max_records) {
+        // まず通し番号だけを集め、取り出す範囲を決めてから該当スロットをコピーして空ける
+        std::vector<std::pair<std::uint64_t, std::size_t>> seqs;
+        for (std::size_t i = 0; i < capacity_; ++i) {
+            Slot& slot = slots_[i];
+            slot.lock();
+            if (slot.seq != 0) {
+                seqs.emplace_back(slot.seq, i);
+            }
+            slot.unlock();
+        }
+        std::sort(seqs.begin(), seqs.end());
+        std::size_t skip = max_records > 0 && seqs.size() > max_records
+            ? seqs.size() - max_records : 0;
+        std::vector<FlightRecord> out;
+        out.reserve(seqs.size() - skip);
+        for (std::size_t i = skip; i < seqs.size(); ++i) {
+            Slot& slot = slots_[seqs[i].second];
+            slot.lock();
+            // 集めた後に新しいレコードで上書きされたスロットは、次の drain に回す
+            if (slot.seq == seqs[i].first) {
+                out.push_back(FlightRecord{slot.path, slot.text});
+                slot.seq = 0;
+            }
+            slot.unlock();
+        }
+        return out;
+    }
+
+    std::size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+        std::uint64_t seq = 0;
+        std::string path;
+        std::string text;
+
+        void lock() {
+            while (busy.test_and_set(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+        void unlock() {
+            busy.clear(std::memory_order_release);
+        }
+    };
+
+    FlightRecorderOptions options_;
+    std::size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint64_t> next_{0};
+};
+
+// ============================================================
+// 時刻インデックス（時間範囲での読み出し用）
+// ============================================================
+
+/**
+ * @brief 時刻インデックスの設定
+ *
+ * every_records 件ごと、または前回のエントリから every_bytes 以上書いたときに
+ * 「書き込み時刻 → そのレコードの先頭オフセット」を1行追記する。
+ */
+struct TimeIndexOptions {
+    std::uint64_t every_records = 1000;
+    std::uint64_t every_bytes = 64 * 1024;
+};
+
+// インデックスファイルのパス（ログファイルの隣に置く）
+inline std::string time_index_path(const std::string& log_path) {
+    return log_path + ".idx";
+}
+
+inline std::int64_t now_epoch_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief ログファイルの時刻インデックス（読み出し側）
+ *
+ * インデックスファイルは "<エポックミリ秒> <バイトオフセット>" の行の並び。
+ * エントリ間のレコードはその2つのエントリの時刻の間に書かれているため、
+ * 時間範囲を含むバイト範囲をエントリの粒度で求められる。
+ */
+class TimeIndex {
+public:
+    struct Entry {
+        std::int64_t time_ms;
+        std::uint64_t offset;
+    };
+
+    static constexpr std::uint64_t kEndOfFile = std::numeric_limits<std::uint64_t>::max();
+
+    // log_path に対応するインデックスを読み込む（無ければ空）
+    static TimeIndex load(const std::string& log_path) {
+        TimeIndex index;
+        std::ifstream file(time_index_path(log_path));
+        long long time_ms = 0;
+        unsigned long long offset = 0;
+        while (file >> time_ms >> offset) {
+            index.entries_.push_back(Entry{time_ms, offset});
+        }
+        return index;
+    }
+
+    const std::vector<Entry>& entries() const {
+        return entries_;
+    }
+
+    /**
+     * @brief [from_ms, to_ms] に書かれたレコードを含むバイト範囲 [first, second)
+     *
+     * second が kEndOfFile ならファイル末尾まで。範囲の前後にはエントリの間隔分だけ
+     * 範囲外のレコードが含まれうる。
+     */
+    std::pair<std::uint64_t, std::uint64_t> byte_range(std::int64_t from_ms, std::int64_t to_ms) const {
+        auto by_time = [](const Entry& e, std::int64_t t) { return e.time_ms < t; };
+        // from_ms より前に書かれたエントリのうち最後のもの
+        auto lo = std::lower_bound(entries_.begin(), entries_.end(), from_ms, by_time);
+        std::uint64_t first = lo == entries_.begin() ? 0 : std::prev(lo)->offset;
+        // to_ms より後に書かれた最初のエントリ
+        auto hi = std::upper_bound(entries_.begin(), entries_.end(), to_ms,
+                                   [](std::int64_t t, const Entry& e) { return t < e.time_ms; });
+        std::uint64_t second = hi == entries_.end() ? kEndOfFile : hi->offset;
+        return {first, std::max(first, second)};
+    }
+
+private:
+    std::vector<Entry> entries_;
+};
+
+/**
+ * @brief インデックスを使って log_path から時間範囲のレコードだけを読み出す
+ */
+inline std::string read_time_range(const std::string& log_path, std::int64_t from_ms, std::int64_t to_ms) {
+    auto [first, second] = TimeIndex::load(log_path).byte_range(from_ms, to_ms);
+    std::ifstream file(log_path, std::ios::binary);
+    if (!file) {
+        return {};
+    }
+    file.seekg(0, std::ios::end);
+    std::uint64_t size = static_cast<std::uint64_t>(file.tellg());
+    first = std::min(first, size);
+    second = std::min(second, size);
+    std::string out(static_cast<std::size_t>(second - first), '\0');
+    file.seekg(static_cast<std::streamoff>(first));
+    file.read(out.data(), static_cast<std::streamsize>(out.size()));
+    out.resize(static_cast<std::size_t>(file.gcount()));
+    return out;
+}
+
+// ============================================================
+// 呼び出し箇所ごとのサンプリング（LOGFF_EVERY_N / LOGFF_RATE_LIMITED で使用）
+// ============================================================
+
+/**
+ * @brief N 回に1回だけ通す（判定は atomic の加算1回）
+ */
+class EveryN {
+public:
+    bool should_log(std::uint64_t n) {
+        std::uint64_t i = count_.fetch_add(1, std::memory_order_relaxed);
+        return n <= 1 || i % n == 0;
+    }
+
+private:
+    std::atomic<std::uint64_t> count_{0};
+};
+
+/**
+ * @brief トークンバケット方式のレート制限（GCRA）
+ *
+ * 次にトークンが満ちる理論時刻だけを atomic に保持する。平均 per_second 回/秒、
+ * 最大 burst 回まで連続して通す。
+ */
+class RateLimiter {
+public:
+    bool allow(double per_second, std::uint32_t burst) {
+        if (per_second <= 0) {
+            return false;
+        }
+        auto interval = static_cast<std::int64_t>(1e9 / per_second);
+        std::int64_t tolerance = interval * static_cast<std::int64_t>(burst > 1 ? burst - 1 : 0);
+        std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::int64_t tat = tat_.load(std::memory_order_relaxed);
+        for (;;) {
+            std::int64_t base = tat > now ? tat : now;
+            if (base - now > tolerance) {
+                return false;
+            }
+            if (tat_.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    std::atomic<std::int64_t> tat_{0};  // theoretical arrival time (ns)
+};
+
+// 呼び出し箇所ごとに1つの状態を持つ（マクロ展開ごとに別のラムダ型になる）
+#define LOGFUNC_SITE_STATE(Type) \
+    ([]() -> logfunc_internal::Type& { static logfunc_internal::Type state; return state; }())
+
+} // namespace logfunc_internal
+
+/**
+ * @brief 構造化ログのキー/値フィールドを作る
+ *
+ * 整数・浮動小数点数・bool・文字列はそのまま型付きで保持する。
+ * それ以外の型は operator<< で文字列化する。
+ * @code
+ * logkv("login", kv("user", name), kv("attempt", 3), kv("ok", true));
+ * @endcode
+ */
+template<typename T>
+inline logfunc_internal::Field kv(std::string_view key, const T& value) {
+    using Field = logfunc_internal::Field;
+    using V = std::decay_t<T>;
+    Field field;
+    field.key = key;
+    if constexpr (std::is_same_v<V, bool>) {
+        field.type = Field::Type::Bool;
+        field.b = value;
+    } else if constexpr (std::is_same_v<V, char>) {
+        field.type = Field::Type::Char;
+        field.c = value;
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+        field.type = Field::Type::Int;
+        field.i = static_cast<std::int64_t>(value);
+    } else if constexpr (std::is_integral_v<V>) {
+        field.type = Field::Type::UInt;
+        field.u = static_cast<std::uint64_t>(value);
+    } else if constexpr (std::is_floating_point_v<V>) {
+        field.type = Field::Type::Double;
+        field.d = static_cast<double>(value);
+    } else if constexpr (std::is_same_v<V, std::nullptr_t>) {
+        field.type = Field::Type::Null;
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        field.type = Field::Type::String;
+        field.str = value;
+    } else {
+        std::ostringstream oss;
+        oss << value;
+        field.type = Field::Type::Owned;
+        field.owned = oss.str();
+    }
+    return field;
+}
+
+/**
+ * @brief ログ機能を提供するLoggerクラス
+ * 
+ * 状態をインスタンス変数として管理し、複数のロガーインスタンスを
+ * 同時に使用可能。テスト容易性と拡張性を向上させる設計。
+ */
+class Logger {
+public:
+    // InputFileCacheをpublicに移動（loginf_try等で使用）
+    struct InputFileCache {
+        std::filesystem::file_time_type last_check_time;
+        std::filesystem::file_time_type last_modify_time;
+        std::chrono::steady_clock::time_point last_access;
+        bool file_exists = false;
+        static constexpr std::chrono::milliseconds cache_duration{10};
+    };
+
+    // パスごとの書き込み統計
+    struct PathMetrics {
+        std::uint64_t records = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    /**
+     * @brief メトリクスのスナップショット（get_metrics() の戻り値）
+     *
+     * file_closes は開いていたハンドルを閉じた回数（close_all、パスの設定変更による閉じ直し）。
+     */
+    struct MetricsSnapshot {
+        std::uint64_t records = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t flushes = 0;
+        std::uint64_t file_opens = 0;
+        std::uint64_t file_closes = 0;
+        std::uint64_t open_files = 0;
+        std::uint64_t watcher_events = 0;
+        std::uint64_t input_reparses = 0;
+        std::uint64_t sampled_out = 0;   // サンプリング / レート制限で捨てた呼び出し
+        std::uint64_t deduplicated = 0;  // 直前と同一のため書き込まなかったレコード
+        logfunc_internal::HistogramData lock_wait_ns;
+        std::map<std::string, PathMetrics> paths;
+
+        std::string to_text() const {
+            std::ostringstream oss;
+            oss << "records " << records << "\n"
+                << "bytes " << bytes << "\n"
+                << "flushes " << flushes << "\n"
+                << "file_opens " << file_opens << "\n"
+                << "file_closes " << file_closes << "\n"
+                << "open_files " << open_files << "\n"
+                << "watcher_events " << watcher_events << "\n"
+                << "input_reparses " << input_reparses << "\n"
+                << "sampled_out " << sampled_out << "\n"
+                << "deduplicated " << deduplicated << "\n"
+                << "lock_wait_ns count=" << lock_wait_ns.count
+                << " mean=" << static_cast<std::uint64_t>(lock_wait_ns.mean())
+                << " p50=" << lock_wait_ns.percentile(0.50)
+                << " p90=" << lock_wait_ns.percentile(0.90)
+                << " p99=" << lock_wait_ns.percentile(0.99)
+                << " max=" << lock_wait_ns.max << "\n";
+            for (const auto& [path, stats] : paths) {
+                oss << "path " << path << " records=" << stats.records
+                    << " bytes=" << stats.bytes << "\n";
+            }
+            return oss.str();
+        }
+
+        std::string to_json() const {
+            std::string out = "{";
+            auto field = [&out](const char* name, std::uint64_t value) {
+                out += '"';
+                out += name;
+                out += "\":";
+                out += std::to_string(value);
+                out += ',';
+            };
+            field("records", records);
+            field("bytes", bytes);
+            field("flushes", flushes);
+            field("file_opens", file_opens);
+            field("file_closes", file_closes);
+            field("open_files", open_files);
+            field("watcher_events", watcher_events);
+            field("input_reparses", input_reparses);
+            field("sampled_out", sampled_out);
+            field("deduplicated", deduplicated);
+            out += "\"lock_wait_ns\":";
+            lock_wait_ns.append_json(out);
+            out += ",\"paths\":{";
+            bool first = true;
+            for (const auto& [path, stats] : paths) {
+                if (!first) out += ',';
+                first = false;
+                logfunc_internal::append_json_string(out, path);
+                out += ":{\"records\":" + std::to_string(stats.records) +
+                       ",\"bytes\":" + std::to_string(stats.bytes) + "}";
+            }
+            out += "}}";
+            return out;
+        }
+    };
+
+    using LockSite = logfunc_internal::LockSite;
+    using StructuredFormat = logfunc_internal::StructuredFormat;
+    using FlightRecorderOptions = logfunc_internal::FlightRecorderOptions;
+    using Sink = logfunc_internal::LogSink;
+    using TimeIndexOptions = logfunc_internal::TimeIndexOptions;
+    using SharedAppendOptions = logfunc_internal::SharedAppendOptions;
+    using DirectIOOptions = logfunc_internal::DirectIOOptions;
+    using SharedBackend = logfunc_internal::SharedBackend;
+    using SharedBackendOptions = logfunc_internal::SharedBackendOptions;
+    using Durability = logfunc_internal::Durability;
+    using DurabilityPolicy = logfunc_internal::DurabilityPolicy;
+    using CommitTicket = logfunc_internal::CommitTicket;
+    using TimeIndex = logfunc_internal::TimeIndex;
+
+    /**
+     * @brief パスを受け取ってシンクを作る関数（ファイルを開くたびに呼ばれる）
+     */
+    using SinkFactory = std::function<std::unique_ptr<Sink>(const std::string& path)>;
+
+    /**
+     * @brief ロック競合プロファイルのレポート（get_lock_profile() の戻り値）
+     *
+     * sites は待ち時間の合計が大きい順（最悪の呼び出し箇所が先頭）に並ぶ。
+     */
+    struct LockProfile {
+        struct Site {
+            LockSite site;
+            std::string name;
+            logfunc_internal::HistogramData wait_ns;
+            logfunc_internal::HistogramData hold_ns;
+        };
+        std::vector<Site> sites;
+
+        std::string to_text() const {
+            std::ostringstream oss;
+            oss << "site            count    wait_p50   wait_p99   wait_max  wait_total"
+                   "    hold_p50   hold_p99   hold_max  hold_total\n";
+            for (const auto& site : sites) {
+                oss << std::left;
+                oss.width(14);
+                oss << site.name << std::right;
+                auto col = [&oss](std::uint64_t v, int width) {
+                    oss.width(width);
+                    oss << v;
+                };
+                col(site.wait_ns.count, 7);
+                col(site.wait_ns.percentile(0.50), 12);
+                col(site.wait_ns.percentile(0.99), 11);
+                col(site.wait_ns.max, 11);
+                col(site.wait_ns.sum, 12);
+                col(site.hold_ns.percentile(0.50), 12);
+                col(site.hold_ns.percentile(0.99), 11);
+                col(site.hold_ns.max, 11);
+                col(site.hold_ns.sum, 12);
+                oss << "\n";
+            }
+            return oss.str();
+        }
+
+        std::string to_json() const {
+            std::string out = "{\"sites\":[";
+            bool first = true;
+            for (const auto& site : sites) {
+                if (!first) out += ',';
+                first = false;
+                out += "{\"site\":";
+                logfunc_internal::append_json_string(out, site.name);
+                out += ",\"wait_ns\":";
+                site.wait_ns.append_json(out);
+                out += ",\"hold_ns\":";
+                site.hold_ns.append_json(out);
+                out += '}';
+            }
+            out += "]}";
+            return out;
+        }
+    };
+
+private:
+    // キャッシュされたファイルハンドルとパスごとの統計
+    struct FileHandle {
+        std::unique_ptr<std::ofstream> stream;
+        std::unique_ptr<logfunc_internal::LogSink> sink;         // set_sink() で登録したパス
+        std::unique_ptr<logfunc_internal::SinkStream> sink_stream;  // LockedStream 用
+        PathMetrics stats;
+        std::string last_record;      // 重複抑制: 直前に書き込んだレコード
+        std::uint64_t repeats = 0;    // 重複抑制: まだ報告していない繰り返し回数
+        std::unique_ptr<std::ofstream> index;   // enable_time_index() で有効にしたパス
+        TimeIndexOptions index_options;
+        std::uint64_t index_records = 0;        // 直前のエントリ以降のレコード数
+        std::uint64_t index_bytes = 0;          // 直前のエントリ以降のバイト数
+        std::int64_t index_last_ms = 0;
+        bool index_pending = false;             // 開いた直後は最初のレコードでエントリを書く
+        Durability durability = Durability::Flush;
+        std::shared_ptr<logfunc_internal::GroupCommitter> committer;   // GroupSync のパス
+
+        bool is_open() const {
+            return sink || (stream && stream->is_open());
+        }
+
+        std::ostream& out() {
+            return sink ? static_cast<std::ostream&>(*sink_stream) : *stream;
+        }
+    };
+
+    // ファイルキャッシュ（インスタンス変数）
+    std::unordered_map<std::string, FileHandle> handles_;
+    std::unordered_map<std::string, SinkFactory> sink_factories_;  // パスごとの出力先
+    std::unordered_map<std::string, TimeIndexOptions> time_indexes_;  // 時刻インデックスを書くパス
+    std::optional<SharedAppendOptions> shared_append_;                 // 複数プロセス追記モード
+    std::optional<DirectIOOptions> direct_io_;                         // ページキャッシュを通さない出力
+    std::shared_ptr<SharedBackend> backend_;                           // 共有バックエンド
+    std::unordered_set<std::string> muted_;                            // 書き込みを捨てるパス
+    std::unordered_map<std::string, DurabilityPolicy> durability_;     // パスごとの永続性
+    mutable std::mutex mtx_;
+    FileHandle null_handle_;
+    FileHandle* default_handle_ = nullptr;   // log_file_path_ のハンドル（mtx_ 保持中に参照）
+    bool silent_mode_ = true;
+    
+    // パス設定（インスタンス変数）
+    std::string log_file_path_ = "log.txt";
+    std::string input_file_path_ = "in.txt";
+    std::string input_checked_path_;           // 存在確認を済ませた入力パス
+    
+    // 入力ファイルキャッシュ（インスタンス変数）
+    InputFileCache input_cache_{
+        std::filesystem::file_time_type::min(),
+        std::filesystem::file_time_type::min(),
+        std::chrono::steady_clock::time_point{},
+        false
+    };
+    
+    // ファイル監視機能（イベント駆動方式）
+    std::unique_ptr<logfunc_internal::FileWatcher> file_watcher_;
+    bool use_event_driven_ = true;  // イベント駆動方式を使用するか
+
+    // メトリクス
+    mutable logfunc_internal::LoggerMetrics metrics_;
+    std::atomic<bool> metrics_enabled_{true};
+    std::map<std::string, PathMetrics> retired_path_stats_;  // 閉じたハンドルの統計
+
+    // ロック競合プロファイラ（有効化時に確保し、Logger 破棄まで保持する）
+    std::unique_ptr<logfunc_internal::LockProfiler> lock_profiler_storage_;
+    std::atomic<logfunc_internal::LockProfiler*> lock_profiler_{nullptr};
+
+    // 構造化ログの設定
+    std::atomic<StructuredFormat> structured_format_{StructuredFormat::Json};
+    std::atomic<bool> structured_timestamp_{true};
+
+    // log / log_to の浮動小数点数の有効桁数（0 は最短表現）
+    std::atomic<int> float_precision_{0};
+
+    // 同一レコードの連続を抑制するか
+    std::atomic<bool> dedup_repeats_{false};
+
+    // フライトレコーダー（有効化のたびに確保し、Logger 破棄まで保持する）
+    std::vector<std::unique_ptr<logfunc_internal::FlightRecorder>> flight_recorder_storage_;
+    std::atomic<logfunc_internal::FlightRecorder*> flight_recorder_{nullptr};
+
+    using MetricCounter = std::atomic<std::uint64_t> logfunc_internal::LoggerMetrics::Shard::*;
+
+    void bump(MetricCounter counter, std::uint64_t n = 1) const {
+        if (metrics_enabled_.load(std::memory_order_relaxed)) {
+            logfunc_internal::LoggerMetrics::add(metrics_.local().*counter, n);
+        }
+    }
+
+    // mtx_ を取得する。競合時のみ待ち時間を計測する
+    // ロックプロファイル有効時は呼び出し箇所ごとに待ち時間と保持時間を記録する
+    logfunc_internal::ProfiledLock lock_mtx(LockSite site) const {
+        auto* profiler = lock_profiler_.load(std::memory_order_acquire);
+        bool metrics = metrics_enabled_.load(std::memory_order_relaxed);
+
+        if (profiler) {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto acquired = std::chrono::steady_clock::now();
+            auto waited = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - start).count());
+            auto& stats = profiler->local(site);
+            stats.wait_ns.record(waited);
+            if (metrics) {
+                metrics_.local().lock_wait_ns.record(waited);
+            }
+            return logfunc_internal::ProfiledLock(std::move(lock), &stats, acquired);
+        }
+
+        std::unique_lock<std::mutex> lock(mtx_, std::try_to_lock);
+        if (!metrics) {
+            if (!lock.owns_lock()) {
+                lock.lock();
+            }
+            return logfunc_internal::ProfiledLock(std::move(lock));
+        }
+        if (lock.owns_lock()) {
+            metrics_.local().lock_wait_ns.record(0);
+            return logfunc_internal::ProfiledLock(std::move(lock));
+        }
+        auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        metrics_.local().lock_wait_ns.record(static_cast<std::uint64_t>(waited));
+        return logfunc_internal::ProfiledLock(std::move(lock));
+    }
+
+    FileHandle& get_null_handle() {
+        if (!null_handle_.stream) {
+            null_handle_.stream = std::make_unique<std::ofstream>();
+        }
+        return null_handle_;
+    }
+
+    FileHandle& get_or_open_handle(const std::string& path_str) {
+        auto it = handles_.find(path_str);
+        if (it != handles_.end() && it->second.is_open()) {
+            return it->second;
+        }
+
+        if (!muted_.empty() && muted_.count(path_str) != 0) {
+            SinkFactory discard = [](const std::string&) {
+                return std::make_unique<logfunc_internal::DiscardSink>();
+            };
+            return open_sink_handle(path_str, discard);
+        }
+        auto factory = sink_factories_.find(path_str);
+        if (factory != sink_factories_.end()) {
+            return open_sink_handle(path_str, factory->second);
+        }
+        if (backend_) {
+            SinkFactory shared = [backend = backend_](const std::string& path) {
+                return std::make_unique<logfunc_internal::BackendSink>(backend, path);
+            };
+            return open_sink_handle(path_str, shared);
+        }
+        if (shared_append_) {
+            SinkFactory shared = [options = *shared_append_](const std::string& path) {
+                return std::make_unique<logfunc_internal::SharedAppendSink>(path, options);
+            };
+            return open_durable_sink_handle(path_str, shared);
+        }
+#ifndef _WIN32
+        if (direct_io_) {
+            SinkFactory direct = [options = *direct_io_](const std::string& path) {
+                return std::make_unique<logfunc_internal::DirectFileSink>(path, options);
+            };
+            return open_durable_sink_handle(path_str, direct);
+        }
+#endif
+        
+        auto stream = std::make_unique<std::ofstream>(
+            path_str, std::ios::app
+        );
+        
+        if (stream && stream->is_open()) {
+            auto policy = durability_.find(path_str);
+            if (policy == durability_.end() || policy->second.level != Durability::None) {
+                stream->rdbuf()->pubsetbuf(nullptr, 0);
+            }
+            auto& handle = handles_[path_str];
+            handle.stream = std::move(stream);
+            open_time_index_locked(path_str, handle);
+            open_durability_locked(path_str, handle);
+            bump(&logfunc_internal::LoggerMetrics::Shard::file_opens);
+            return handle;
+        }
+        return open_failed(path_str);
+    }
+
+    void open_time_index_locked(const std::string& path_str, FileHandle& handle) {
+        handle.index.reset();
+        auto it = time_indexes_.find(path_str);
+        if (it == time_indexes_.end()) {
+            return;
+        }
+        auto index = std::make_unique<std::ofstream>(logfunc_internal::time_index_path(path_str), std::ios::app);
+        if (!index->is_open()) {
+            std::cerr << "[logfunc] Warning: Failed to open time index for: " << path_str << std::endl;
+            return;
+        }
+        // 追記モードでは最初の書き込みまで tellp() が 0 を返すため、末尾に移動しておく
+        handle.stream->seekp(0, std::ios::end);
+        handle.index = std::move(index);
+        handle.index_options = it->second;
+        handle.index_records = 0;
+        handle.index_bytes = 0;
+        handle.index_pending = true;
+    }
+
+    // 次に書くレコードの先頭位置をインデックスに記録するか判定して記録する
+    void index_record_locked(FileHandle& handle, std::size_t size) {
+        const auto& options = handle.index_options;
+        bool due = handle.index_pending ||
+                   (options.every_records > 0 && handle.index_records >= options.every_records) ||
+                   (options.every_bytes > 0 && handle.index_bytes >= options.every_bytes);
+        if (due) {
+            auto offset = handle.stream->tellp();
+            if (offset >= 0) {
+                // システム時計が戻っても検索できるよう、時刻は単調にする
+                handle.index_last_ms = std::max(handle.index_last_ms, logfunc_internal::now_epoch_ms());
+                *handle.index << handle.index_last_ms << ' ' << static_cast<std::uint64_t>(offset) << '\n';
+            }
+            handle.index_pending = false;
+            handle.index_records = 0;
+            handle.index_bytes = 0;
+        }
+        handle.index_records += 1;
+        handle.index_bytes += size;
+    }
+
+    FileHandle& open_failed(const std::string& path_str) {
+        if (silent_mode_) {
+            std::cerr << "[logfunc] Warning: Failed to open file: " << path_str << std::endl;
+            return get_null_handle();
+        } else {
+            throw std::runtime_error("Failed to open file: " + path_str);
+        }
+    }
+
+    FileHandle& open_sink_handle(const std::string& path_str, const SinkFactory& factory) {
+        std::unique_ptr<logfunc_internal::LogSink> sink;
+        try {
+            sink = factory(path_str);
+        } catch (const std::exception& e) {
+            if (!silent_mode_) {
+                throw;
+            }
+            std::cerr << "[logfunc] Warning: " << e.what() << std::endl;
+            return get_null_handle();
+        }
+        if (!sink) {
+            return open_failed(path_str);
+        }
+        // 時刻インデックスはファイルのオフセットを記録するため、シンク経由のパスには書けない
+        if (!time_indexes_.empty() && time_indexes_.count(path_str) != 0 && muted_.count(path_str) == 0) {
+            std::cerr << "[logfunc] Warning: time index is not written for " << path_str
+                      << " (the path is written through a sink)" << std::endl;
+        }
+        auto& handle = handles_[path_str];
+        handle.stream.reset();
+        handle.sink_stream = std::make_unique<logfunc_internal::SinkStream>(*sink);
+        handle.sink = std::move(sink);
+        bump(&logfunc_internal::LoggerMetrics::Shard::file_opens);
+        return handle;
+    }
+
+    // 共有追記・direct I/O のハンドルにも永続性の設定を適用する
+    FileHandle& open_durable_sink_handle(const std::string& path_str, const SinkFactory& factory) {
+        auto& handle = open_sink_handle(path_str, factory);
+        if (handle.sink) {
+            open_durability_locked(path_str, handle);
+        }
+        return handle;
+    }
+
+    // GroupSync のパスには同期スレッドを付ける
+    void open_durability_locked(const std::string& path_str, FileHandle& handle) {
+        handle.durability = Durability::Flush;
+        handle.committer.reset();
+        auto it = durability_.find(path_str);
+        if (it == durability_.end()) {
+            return;
+        }
+        handle.durability = it->second.level;
+        if (it->second.level != Durability::GroupSync) {
+            return;
+        }
+        try {
+            handle.committer = std::make_shared<logfunc_internal::GroupCommitter>(path_str, it->second.window);
+        } catch (const std::exception& e) {
+            if (!silent_mode_) {
+                throw;
+            }
+            std::cerr << "[logfunc] Warning: " << e.what() << std::endl;
+            handle.durability = Durability::Flush;
+        }
+    }
+
+    std::ostream& get_or_open_internal(const std::string& path_str) {
+        return get_or_open_handle(path_str).out();
+    }
+
+    // mtx_ を保持した状態で1レコードを書き込む
+    void write_locked(FileHandle& handle, std::string_view content) {
+        if (dedup_repeats_.load(std::memory_order_relaxed)) {
+            if (!handle.last_record.empty() && content == handle.last_record) {
+                handle.repeats += 1;
+                bump(&logfunc_internal::LoggerMetrics::Shard::deduplicated);
+                return;
+            }
+            flush_repeats_locked(handle);
+            handle.last_record.assign(content.data(), content.size());
+        }
+        write_raw_locked(handle, content);
+    }
+
+    // 抑制した繰り返しがあれば "last message repeated N times" を書き出す
+    void flush_repeats_locked(FileHandle& handle) {
+        if (handle.repeats == 0) {
+            return;
+        }
+        char buffer[64];
+        char* p = buffer;
+        std::memcpy(p, "last message repeated ", 22);
+        p = logfunc_internal::write_uint(p + 22, handle.repeats);
+        std::memcpy(p, " times\n", 7);
+        p += 7;
+        handle.repeats = 0;
+        write_raw_locked(handle, std::string_view(buffer, static_cast<std::size_t>(p - buffer)));
+    }
+
+    void write_raw_locked(FileHandle& handle, std::string_view content) {
+        if (handle.sink) {
+            // get_or_open で書いた内容が残っていれば先に渡し、順序を保つ
+            handle.sink_stream->commit();
+            handle.sink->write(content);
+        } else {
+            if (handle.index) {
+                index_record_locked(handle, content.size());
+            }
+            auto& stream = *handle.stream;
+            stream << content;
+            if (handle.durability != Durability::None) {
+                stream.flush();
+            }
+        }
+        if (handle.committer) {
+            // direct I/O などのシンクはバッファにためるので、OS に渡してから同期の対象にする
+            if (handle.sink) {
+                handle.sink->flush();
+            }
+            handle.committer->note_write();
+        }
+        handle.stats.records += 1;
+        handle.stats.bytes += content.size();
+        if (metrics_enabled_.load(std::memory_order_relaxed)) {
+            auto& shard = metrics_.local();
+            logfunc_internal::LoggerMetrics::add(shard.records);
+            logfunc_internal::LoggerMetrics::add(shard.bytes, content.size());
+            logfunc_internal::LoggerMetrics::add(shard.flushes);
+        }
+    }
+
+    void flush_handle_locked(FileHandle& handle) {
+        if (handle.sink) {
+            handle.sink_stream->commit();
+            handle.sink->flush();
+        } else {
+            handle.stream->flush();
+            if (handle.index) {
+                handle.index->flush();
+            }
+        }
+    }
+
+    // mtx_ を保持した状態で全ハンドルを閉じる（統計は保持する）
+    void close_all_locked() {
+        for (auto& [path, handle] : handles_) {
+            retire_handle_locked(path, handle);
+        }
+        handles_.clear();
+    }
+
+    // ハンドルを閉じる前の後処理（保留中の繰り返しの書き出しと統計の退避）
+    void retire_handle_locked(const std::string& path, FileHandle& handle) {
+        // retire したハンドルは呼び出し側で削除されるので、覚えているポインタも捨てる
+        if (&handle == default_handle_) {
+            default_handle_ = nullptr;
+        }
+        if (handle.sink_stream) {
+            handle.sink_stream->commit();
+        }
+        if (handle.is_open()) {
+            flush_repeats_locked(handle);
+            bump(&logfunc_internal::LoggerMetrics::Shard::file_closes);
+        }
+        if (handle.committer) {
+            handle.committer->close();
+        }
+        auto& retired = retired_path_stats_[path];
+        retired.records += handle.stats.records;
+        retired.bytes += handle.stats.bytes;
+    }
+
+public:
+    Logger() = default;
+    
+    // コピー禁止（ファイルハンドルを持つため）
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    
+    // ムーブは許可
+    Logger(Logger&&) = default;
+    Logger& operator=(Logger&&) = default;
+    
+    ~Logger() {
+        close_all();
+    }
+
+    // === パス設定 ===
+    void set_log_path(std::string_view log_path) {
+        auto lock = lock_mtx(LockSite::Config);
+        log_file_path_ = log_path;
+        default_handle_ = nullptr;
+    }
+    
+    std::string get_log_path() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return log_file_path_;
+    }
+    
+    void set_input_path(std::string_view input_path) {
+        auto lock = lock_mtx(LockSite::Config);
+        input_file_path_ = input_path;
+    }
+    
+    std::string get_input_path() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return input_file_path_;
+    }
+
+    // === ファイルキャッシュ操作 ===
+    // シンク経由のパス（圧縮・共有追記・直接 I/O・共有バックエンド・mute）はシンクのストリームを返す
+    std::ostream& get_or_open(std::string_view path) {
+        auto lock = lock_mtx(LockSite::Other);
+        std::string path_str{path};
+        return get_or_open_internal(path_str);
+    }
+    
+    void write_atomic(std::string_view path, std::string_view content) {
+        if (auto* recorder = flight_recorder_.load(std::memory_order_acquire)) {
+            record_flight(*recorder, path, content);
+            return;
+        }
+        write_file(path, content);
+    }
+
+private:
+    // フライトレコーダーを経由せずにファイルへ書き込む
+    void write_file(std::string_view path, std::string_view content) {
+        auto lock = lock_mtx(LockSite::LogTo);
+        std::string path_str{path};
+        write_locked(get_or_open_handle(path_str), content);
+    }
+
+    // デフォルトのログファイルへ書き込む
+    void write_default(std::string_view content) {
+        if (auto* recorder = flight_recorder_.load(std::memory_order_acquire)) {
+            record_flight(*recorder, {}, content);
+            return;
+        }
+        write_default_file(content);
+    }
+
+    // フライトレコーダーを経由せずにデフォルトのログファイルへ書き込む
+    // log_file_path_ はロック内で参照する（set_log_path との競合を避けるため）
+    // 開いたハンドルは default_handle_ に覚えておき、2 回目以降はパスを引かない
+    void write_default_file(std::string_view content) {
+        auto lock = lock_mtx(LockSite::Log);
+        FileHandle* handle = default_handle_;
+        if (!handle) {
+            handle = &get_or_open_handle(log_file_path_);
+            // 開けなかった場合は次回も開き直す
+            default_handle_ = handle != &null_handle_ ? handle : nullptr;
+        }
+        write_locked(*handle, content);
+    }
+
+    void record_flight(logfunc_internal::FlightRecorder& recorder, std::string_view path,
+                       std::string_view content) {
+        recorder.record(path, content);
+        const auto& options = recorder.options();
+        if (!options.trigger.empty() && content.find(options.trigger) != std::string_view::npos) {
+            dump_flight_recorder(options.dump_path, options.dump_records);
+        }
+    }
+
+public:
+    class LockedStream {
+    private:
+        std::ostream& stream_;
+        logfunc_internal::ProfiledLock lock_;
+        
+    public:
+        LockedStream(std::ostream& stream, std::unique_lock<std::mutex> lock)
+            : stream_(stream), lock_(std::move(lock)) {}
+
+        LockedStream(std::ostream& stream, logfunc_internal::ProfiledLock lock)
+            : stream_(stream), lock_(std::move(lock)) {}
+        
+        template<typename T>
+        LockedStream& operator<<(T&& value) {
+            stream_ << std::forward<T>(value);
+            return *this;
+        }
+        
+        void flush() { stream_.flush(); }
+
+        // シンクに書くパスでは、組み立てた内容をここで1レコードとして渡す
+        ~LockedStream() {
+            if (lock_.owns_lock()) {
+                if (auto* sink_stream = dynamic_cast<logfunc_internal::SinkStream*>(&stream_)) {
+                    sink_stream->commit();
+                }
+            }
+        }
+
+        LockedStream(LockedStream&&) = default;
+        LockedStream& operator=(LockedStream&&) = default;
+        LockedStream(const LockedStream&) = delete;
+        LockedStream& operator=(const LockedStream&) = delete;
+    };
+
+    LockedStream get_locked_stream(std::string_view path) {
+        auto lock = lock_mtx(LockSite::LockedStream);
+        std::string path_str{path};
+        auto& stream = get_or_open_internal(path_str);
+        return LockedStream(stream, std::move(lock));
+    }
+
+    /**
+     * @brief ロックを保持せずに複数パートのレコードを組み立てるビルダー
+     *
+     * operator<< の内容は専用のバッファに蓄積され、commit() または破棄時に
+     * 1回の write_atomic としてまとめて書き込まれる。LockedStream と同じく
+     * 他のスレッドの出力と混ざらないが、組み立て中は mtx_ を保持しない。
+     */
+    class RecordBuilder {
+    private:
+        Logger* logger_;
+        std::string path_;       // 空の場合はデフォルトのログファイル
+        std::ostringstream buffer_;
+        bool active_ = true;
+
+    public:
+        RecordBuilder(Logger& logger, std::string_view path)
+            : logger_(&logger), path_(path) {}
+
+        RecordBuilder(RecordBuilder&& other) noexcept
+            : logger_(other.logger_), path_(std::move(other.path_)),
+              buffer_(std::move(other.buffer_)), active_(other.active_) {
+            other.active_ = false;
+        }
+
+        RecordBuilder& operator=(RecordBuilder&&) = delete;
+        RecordBuilder(const RecordBuilder&) = delete;
+        RecordBuilder& operator=(const RecordBuilder&) = delete;
+
+        ~RecordBuilder() {
+            try {
+                commit();
+            } catch (const std::exception& e) {
+                std::cerr << "[logfunc] Warning: Failed to commit record: " << e.what() << std::endl;
+            }
+        }
+
+        template<typename T>
+        RecordBuilder& operator<<(T&& value) {
+            buffer_ << std::forward<T>(value);
+            return *this;
+        }
+
+        // std::endl 等のマニピュレータ
+        RecordBuilder& operator<<(std::ostream& (*manip)(std::ostream&)) {
+            buffer_ << manip;
+            return *this;
+        }
+
+        /**
+         * @brief 蓄積した内容を書き込む（2回目以降は何もしない）
+         */
+        void commit() {
+            if (!active_) {
+                return;
+            }
+            active_ = false;
+            std::string content = buffer_.str();
+            if (content.empty()) {
+                return;
+            }
+            if (path_.empty()) {
+                logger_->write_default(content);
+            } else {
+                logger_->write_atomic(path_, content);
+            }
+        }
+
+        /**
+         * @brief 蓄積した内容を書き込まずに破棄する
+         */
+        void discard() {
+            active_ = false;
+        }
+    };
+
+    // デフォルトのログファイル向けのレコードビルダー
+    RecordBuilder begin_record() {
+        return RecordBuilder(*this, {});
+    }
+
+    RecordBuilder begin_record(std::string_view path) {
+        return RecordBuilder(*this, path);
     }
     
     void flush(std::string_view path = {}) {
-        std::lock_guard<std::mutex> lock(mtx_);
+        auto lock = lock_mtx(LockSite::Flush);
         
         if (!path.empty()) {
-            std::string path_str{path};
-            auto it = handles_.find(path_str);
-            if (it != handles_.end() && it->second) {
-                it->second->flush();
+            std::string path_str{path};
+            auto it = handles_.find(path_str);
+            if (it != handles_.end() && it->second.is_open()) {
+                flush_repeats_locked(it->second);
+                flush_handle_locked(it->second);
+                bump(&logfunc_internal::LoggerMetrics::Shard::flushes);
+            }
+        } else {
+            for (auto& [_, handle] : handles_) {
+                if (handle.is_open()) {
+                    flush_repeats_locked(handle);
+                    flush_handle_locked(handle);
+                    bump(&logfunc_internal::LoggerMetrics::Shard::flushes);
+                }
+            }
+        }
+    }
+    
+    void close_all() {
+        auto lock = lock_mtx(LockSite::Other);
+        close_all_locked();
+    }
+
+    // === サンプリング・重複抑制 ===
+
+    /**
+     * @brief 直前と同一のレコードの連続を書き込まず、回数だけ記録する（デフォルト: 無効）
+     *
+     * 異なるレコードが来たとき、または flush / close_all のときに
+     * "last message repeated N times" を1行書き出す。比較はファイルごとに行う。
+     */
+    void set_dedup_repeats(bool enabled) {
+        auto lock = lock_mtx(LockSite::Config);
+        dedup_repeats_.store(enabled, std::memory_order_relaxed);
+        if (!enabled) {
+            for (auto& [_, handle] : handles_) {
+                if (handle.is_open()) {
+                    flush_repeats_locked(handle);
+                }
+                handle.last_record.clear();
+            }
+        }
+    }
+
+    bool is_dedup_repeats() const {
+        return dedup_repeats_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief サンプリング / レート制限で捨てた呼び出しを数える（LOGFF_EVERY_N 等が使用）
+     */
+    void count_sampled_out(std::uint64_t n = 1) const {
+        bump(&logfunc_internal::LoggerMetrics::Shard::sampled_out, n);
+    }
+
+    void set_silent_mode(bool silent) {
+        auto lock = lock_mtx(LockSite::Config);
+        silent_mode_ = silent;
+    }
+    
+    bool is_silent_mode() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return silent_mode_;
+    }
+
+    // === メトリクス ===
+
+    /**
+     * @brief メトリクス収集の有効/無効を設定（デフォルト: 有効）
+     */
+    void set_metrics_enabled(bool enabled) {
+        metrics_enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool is_metrics_enabled() const {
+        return metrics_enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 全スレッドのカウンタを集計したスナップショットを取得
+     */
+    MetricsSnapshot get_metrics() const {
+        MetricsSnapshot snapshot;
+        metrics_.for_each_shard([&snapshot](const logfunc_internal::LoggerMetrics::Shard& shard) {
+            snapshot.records += shard.records.load(std::memory_order_relaxed);
+            snapshot.bytes += shard.bytes.load(std::memory_order_relaxed);
+            snapshot.flushes += shard.flushes.load(std::memory_order_relaxed);
+            snapshot.file_opens += shard.file_opens.load(std::memory_order_relaxed);
+            snapshot.file_closes += shard.file_closes.load(std::memory_order_relaxed);
+            snapshot.watcher_events += shard.watcher_events.load(std::memory_order_relaxed);
+            snapshot.input_reparses += shard.input_reparses.load(std::memory_order_relaxed);
+            snapshot.sampled_out += shard.sampled_out.load(std::memory_order_relaxed);
+            snapshot.deduplicated += shard.deduplicated.load(std::memory_order_relaxed);
+            shard.lock_wait_ns.collect(snapshot.lock_wait_ns);
+        });
+
+        auto lock = lock_mtx(LockSite::Other);
+        snapshot.paths = retired_path_stats_;
+        for (const auto& [path, handle] : handles_) {
+            auto& stats = snapshot.paths[path];
+            stats.records += handle.stats.records;
+            stats.bytes += handle.stats.bytes;
+            if (handle.is_open()) {
+                ++snapshot.open_files;
+            }
+        }
+        return snapshot;
+    }
+
+    /**
+     * @brief メトリクスを0に戻す
+     */
+    void reset_metrics() {
+        metrics_.reset();
+        auto lock = lock_mtx(LockSite::Other);
+        retired_path_stats_.clear();
+        for (auto& [_, handle] : handles_) {
+            handle.stats = PathMetrics{};
+        }
+    }
+
+    // === ロック競合プロファイル ===
+
+    /**
+     * @brief ロック競合プロファイルの有効/無効を設定（デフォルト: 無効）
+     *
+     * 有効時は mtx_ を取得するたびに呼び出し箇所（log / log_to / flush /
+     * LockedStream / 設定 / その他）ごとの待ち時間と保持時間を記録する。
+     */
+    void set_lock_profiling(bool enabled) {
+        auto lock = lock_mtx(LockSite::Config);
+        if (enabled) {
+            if (!lock_profiler_storage_) {
+                lock_profiler_storage_ = std::make_unique<logfunc_internal::LockProfiler>();
+            }
+            lock_profiler_.store(lock_profiler_storage_.get(), std::memory_order_release);
+        } else {
+            lock_profiler_.store(nullptr, std::memory_order_release);
+        }
+    }
+
+    bool is_lock_profiling() const {
+        return lock_profiler_.load(std::memory_order_acquire) != nullptr;
+    }
+
+    /**
+     * @brief 呼び出し箇所ごとの集計を、待ち時間の合計が大きい順に返す
+     */
+    LockProfile get_lock_profile() const {
+        LockProfile profile;
+        logfunc_internal::LockProfiler* profiler;
+        {
+            auto lock = lock_mtx(LockSite::Other);
+            profiler = lock_profiler_storage_.get();
+        }
+        if (!profiler) {
+            return profile;
+        }
+        for (std::size_t i = 0; i < logfunc_internal::LockProfiler::kSites; ++i) {
+            auto site = static_cast<LockSite>(i);
+            LockProfile::Site entry{site, logfunc_internal::lock_site_name(site), {}, {}};
+            profiler->collect(site, entry.wait_ns, entry.hold_ns);
+            if (entry.wait_ns.count > 0) {
+                profile.sites.push_back(std::move(entry));
+            }
+        }
+        std::sort(profile.sites.begin(), profile.sites.end(),
+                  [](const LockProfile::Site& a, const LockProfile::Site& b) {
+                      return a.wait_ns.sum > b.wait_ns.sum;
+                  });
+        return profile;
+    }
+
+    void reset_lock_profile() {
+        logfunc_internal::LockProfiler* profiler;
+        {
+            auto lock = lock_mtx(LockSite::Other);
+            profiler = lock_profiler_storage_.get();
+        }
+        if (profiler) {
+            profiler->reset();
+        }
+    }
+
+    // === ログ出力 ===
+    template<typename... Args>
+    void log(Args&&... args) {
+        render_and_write([this](std::string_view content) { write_default(content); },
+                         std::forward<Args>(args)...);
+    }
+    
+#ifdef HAS_STD_FORMAT
+    template<typename... Args>
+    void log_formatted(std::string_view format_str, Args&&... args) {
+        std::string content = std::vformat(format_str, std::make_format_args(args...));
+        write_default(content);
+    }
+#endif
+
+    template<typename... Args>
+    void log_to(std::string_view filepath, Args&&... args) {
+        render_and_write([this, filepath](std::string_view content) { write_atomic(filepath, content); },
+                         std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief log / log_to での浮動小数点数の有効桁数を設定
+     *
+     * 0（デフォルト）は往復可能な最短表現。operator<< と同じ出力にするには 6 を指定する。
+     */
+    void set_float_precision(int digits) {
+        float_precision_.store(digits > 0 ? digits : 0, std::memory_order_relaxed);
+    }
+
+    int get_float_precision() const {
+        return float_precision_.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * @brief 引数の型に応じた経路で1レコードを整形し、write に渡す
+     *
+     * - 文字列リテラル1つ: コピーせずそのまま書き込む
+     * - 固定長の型だけ（数値・文字・文字列リテラル）: 上限サイズをコンパイル時に求め、
+     *   スタック上のバッファへ伸長チェックなしで整形する
+     * - 数値と文字列だけ: スレッドごとのバッファへ整形する
+     * - それ以外: operator<< で整形する
+     */
+    template<typename Write, typename... Args>
+    void render_and_write(Write&& write, Args&&... args) const {
+        using namespace logfunc_internal;
+        if constexpr (is_single_char_array_v<Args...>) {
+            write(char_array_view(args...));
+        } else if constexpr (fixed_text_bound_v<Args...> > 0) {
+            char buffer[fixed_text_bound_v<Args...>];
+            char* p = buffer;
+            int precision = get_float_precision();
+            ((p = write_text(p, args, precision)), ...);
+            write(std::string_view(buffer, static_cast<std::size_t>(p - buffer)));
+        } else if constexpr ((is_fast_text_arg_v<Args> && ...)) {
+            write(render_text(args...));
+        } else {
+            write(render_stream(std::forward<Args>(args)...));
+        }
+    }
+
+    // 数値と文字列だけの呼び出しはスレッドごとのバッファへ直接整形する
+    template<typename... Args>
+    std::string_view render_text(Args&... args) const {
+        std::string& buffer = logfunc_internal::format_buffer();
+        int precision = get_float_precision();
+        (logfunc_internal::append_text(buffer, args, precision), ...);
+        return buffer;
+    }
+
+    // それ以外の型やマニピュレータを含む呼び出しは operator<< で整形する
+    // 浮動小数点数の引数は、マニピュレータで書式を変えていなければ高速経路と同じ表現にする
+    template<typename... Args>
+    std::string render_stream(Args&&... args) const {
+        std::ostringstream oss;
+        int precision = get_float_precision();
+        if (precision > 0) {
+            oss.precision(precision);
+        }
+        auto float_flags = oss.flags() & kFloatFormatFlags;
+        auto float_precision = oss.precision();
+        (stream_arg(oss, std::forward<Args>(args), precision, float_flags, float_precision), ...);
+        return oss.str();
+    }
+
+    static constexpr std::ios::fmtflags kFloatFormatFlags =
+        std::ios::floatfield | std::ios::showpoint | std::ios::showpos | std::ios::uppercase;
+
+    template<typename T>
+    static void stream_arg(std::ostream& os, T&& value, int precision,
+                           std::ios::fmtflags float_flags, std::streamsize float_precision) {
+        using V = std::remove_cv_t<std::remove_reference_t<T>>;
+        if constexpr (std::is_floating_point_v<V>) {
+            if ((os.flags() & kFloatFormatFlags) == float_flags && os.precision() == float_precision &&
+                os.width() == 0) {
+                char buffer[logfunc_internal::kMaxFloatChars];
+                char* end = std::is_same_v<V, float>
+                    ? logfunc_internal::write_floating(buffer, value, precision)
+                    : logfunc_internal::write_floating(buffer, static_cast<double>(value), precision);
+                os.write(buffer, end - buffer);
+                return;
+            }
+        }
+        os << std::forward<T>(value);
+    }
+
+public:
+
+    // === 出力先（シンク） ===
+
+    /**
+     * @brief path への書き込みを std::ofstream ではなく factory が作るシンクに渡す
+     *
+     * シンクはファイルを開くとき（最初の書き込みと close_all 後の再オープン時）に作られ、
+     * close_all で破棄される。空の factory を渡すと通常のファイル出力に戻す。
+     * 既に開いているハンドルは閉じてから切り替える。
+     */
+    void set_sink(std::string_view path, SinkFactory factory) {
+        auto lock = lock_mtx(LockSite::Config);
+        std::string path_str{path};
+        auto it = handles_.find(path_str);
+        if (it != handles_.end()) {
+            retire_handle_locked(path_str, it->second);
+            handles_.erase(it);
+        }
+        if (factory) {
+            sink_factories_[path_str] = std::move(factory);
+        } else {
+            sink_factories_.erase(path_str);
+        }
+    }
+
+    /**
+     * @brief path への書き込みを止める／再開する
+     *
+     * 止めている間は開いたハンドルが書き込みを捨てるだけなので、呼び出しごとの判定は増えない。
+     * set_sink() の設定は保持し、再開すると元の出力先に戻る。既に開いているハンドルは閉じてから切り替える。
+     */
+    void set_muted(std::string_view path, bool muted) {
+        set_muted({{std::string(path), muted}});
+    }
+
+    /**
+     * @brief 複数のパスの停止／再開を 1 回のロックで切り替える
+     */
+    void set_muted(const std::vector<std::pair<std::string, bool>>& changes) {
+        auto lock = lock_mtx(LockSite::Config);
+        for (const auto& [path, muted] : changes) {
+            auto it = handles_.find(path);
+            if (it != handles_.end()) {
+                retire_handle_locked(path, it->second);
+                handles_.erase(it);
+            }
+            if (muted) {
+                muted_.insert(path);
+            } else {
+                muted_.erase(path);
+            }
+        }
+    }
+
+    bool is_muted(std::string_view path) const {
+        auto lock = lock_mtx(LockSite::Config);
+        return muted_.count(std::string(path)) != 0;
+    }
+
+    // === 複数プロセスからの追記 ===
+
+    /**
+     * @brief 複数プロセスが同じファイルに書くためのモードにする
+     *
+     * set_sink() を指定していないすべてのパスを、レコードごとに 1 回の O_APPEND write
+     * で書く（atomic_write_max を超えるレコードはファイルロックを取って書く）。
+     * 各プロセスがそれぞれの Logger でこのモードを有効にすれば、レコードは混ざらない。
+     * 開いているハンドルは閉じてから切り替える。
+     */
+    void enable_shared_append(SharedAppendOptions options = {}) {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        shared_append_ = options;
+    }
+
+    void disable_shared_append() {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        shared_append_.reset();
+    }
+
+    bool is_shared_append() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return shared_append_.has_value();
+    }
+
+    // === ページキャッシュを通さない出力 ===
+
+    /**
+     * @brief ファイル出力を O_DIRECT + fallocate で行うモードにする（POSIX のみ）
+     *
+     * set_sink() を指定していないすべてのパスを、アラインしたバッファ単位で
+     * ページキャッシュを通さずに書く。バッファにたまった分は flush() か
+     * close_all() まで読めない。共有追記モードが有効ならそちらを優先する。
+     * 開いているハンドルは閉じてから切り替える。Windows では何もしない。
+     */
+    void enable_direct_io(DirectIOOptions options = {}) {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        direct_io_ = options;
+    }
+
+    void disable_direct_io() {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        direct_io_.reset();
+    }
+
+    bool is_direct_io() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return direct_io_.has_value();
+    }
+
+    // === 共有バックエンド ===
+
+    /**
+     * @brief ファイル出力を共有バックエンドに任せる
+     *
+     * set_sink() を指定していないすべてのパスを backend のファイル表で開き、
+     * 書き込みは backend の書き込みスレッドが行う。同じバックエンドにつないだ Logger 同士は、
+     * 同じファイルを別のパスで指していても記述子を 1 つだけ使い、行は混ざらない。
+     * 省略時はプロセスで 1 つのバックエンドを使う。共有追記・direct I/O より優先し、
+     * set_durability() は効かない。開いているハンドルは閉じてから切り替える。
+     */
+    void attach_backend(std::shared_ptr<SharedBackend> backend = SharedBackend::instance()) {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        backend_ = std::move(backend);
+    }
+
+    void detach_backend() {
+        auto lock = lock_mtx(LockSite::Config);
+        close_all_locked();
+        backend_.reset();
+    }
+
+    bool has_backend() const {
+        auto lock = lock_mtx(LockSite::Config);
+        return backend_ != nullptr;
+    }
+
+    // === 永続性 ===
+
+    /**
+     * @brief path の永続性を設定する
+     *
+     * None はレコードを stdio のバッファにためる（flush() / close_all() で書く）。
+     * Flush はレコードごとに OS に渡す（デフォルト）。GroupSync はさらに、
+     * window の間に届いたレコードを 1 回の fdatasync でまとめて同期する。
+     * 呼び出し側が同期を待つ場合は commit_ticket() を使う。
+     * set_sink() で登録したパスには効かない。既に開いているハンドルは閉じてから切り替える。
+     */
+    void set_durability(std::string_view path, DurabilityPolicy policy) {
+        auto lock = lock_mtx(LockSite::Config);
+        std::string path_str{path};
+        auto it = handles_.find(path_str);
+        if (it != handles_.end()) {
+            retire_handle_locked(path_str, it->second);
+            handles_.erase(it);
+        }
+        durability_[path_str] = policy;
+    }
+
+    DurabilityPolicy get_durability(std::string_view path) const {
+        auto lock = lock_mtx(LockSite::Config);
+        auto it = durability_.find(std::string(path));
+        return it != durability_.end() ? it->second : DurabilityPolicy{};
+    }
+
+    /**
+     * @brief path にここまでに書いたレコードが同期されたら完了するチケットを返す
+     *
+     * 他のスレッドが書いたレコードや LockedStream の内容も含む。
+     * GroupSync でないパス、まだ開いていないパスでは完了済みのチケットを返す。
+     */
+    CommitTicket commit_ticket(std::string_view path) {
+        auto lock = lock_mtx(LockSite::Flush);
+        auto it = handles_.find(std::string(path));
+        if (it == handles_.end() || !it->second.committer) {
+            return {};
+        }
+        // LockedStream の内容はシンクに直接渡るので、ここで OS に渡す
+        flush_handle_locked(it->second);
+        auto& committer = it->second.committer;
+        return CommitTicket(committer, committer->note_write());
+    }
+
+    // === 時刻インデックス ===
+
+    /**
+     * @brief path に時刻インデックス（path + ".idx"）を書く
+     *
+     * 一定件数・一定バイトごとに書き込み時刻とレコードの先頭オフセットを記録する。
+     * 読み出しは log_read_time_range() / Logger::TimeIndex を使う。
+     * シンク経由のパス（set_sink()、enable_shared_append()、enable_direct_io()、attach_backend()）
+     * には書かず、開くときに警告を出す。既に開いているハンドルは閉じてから切り替える。
+     */
+    void enable_time_index(std::string_view path, TimeIndexOptions options = {}) {
+        auto lock = lock_mtx(LockSite::Config);
+        std::string path_str{path};
+        auto it = handles_.find(path_str);
+        if (it != handles_.end()) {
+            retire_handle_locked(path_str, it->second);
+            handles_.erase(it);
+        }
+        time_indexes_[path_str] = options;
+    }
+
+    void disable_time_index(std::string_view path) {
+        auto lock = lock_mtx(LockSite::Config);
+        std::string path_str{path};
+        auto it = handles_.find(path_str);
+        if (it != handles_.end()) {
+            retire_handle_locked(path_str, it->second);
+            handles_.erase(it);
+        }
+        time_indexes_.erase(path_str);
+    }
+
+    // === フライトレコーダー ===
+
+    /**
+     * @brief フライトレコーダーを有効化する
+     *
+     * 有効な間、log / log_to / logkv / RecordBuilder のレコードはファイルに書かず、
+     * メモリ上のリングバッファ（古いものから上書き）に保持する。
+     * dump_flight_recorder() または trigger を含むレコードでファイルへ書き出す。
+     * LockedStream はリングを経由しない。
+     */
+    void enable_flight_recorder(FlightRecorderOptions options = {}) {
+        auto recorder = std::make_unique<logfunc_internal::FlightRecorder>(std::move(options));
+        auto lock = lock_mtx(LockSite::Config);
+        // 書き込み中のスレッドが参照している可能性があるため、古いリングも破棄しない
+        flight_recorder_storage_.push_back(std::move(recorder));
+        flight_recorder_.store(flight_recorder_storage_.back().get(), std::memory_order_release);
+    }
+
+    /**
+     * @brief フライトレコーダーを無効化し、通常のファイル出力に戻す（保持中のレコードは捨てる）
+     */
+    void disable_flight_recorder() {
+        flight_recorder_.store(nullptr, std::memory_order_release);
+    }
+
+    bool is_flight_recorder_enabled() const {
+        return flight_recorder_.load(std::memory_order_acquire) != nullptr;
+    }
+
+    /**
+     * @brief 保持しているレコードを古い順にファイルへ書き出し、リングから消去する
+     *
+     * 出力先を指定しない場合（path も FlightRecorderOptions::dump_path も空）は、
+     * 各レコードを記録時の出力先（log_to のパス、log はデフォルトのログファイル）へ戻す。
+     * 出力先を指定した場合は、全パスのレコードを古い順にその1ファイルへまとめる。
+     *
+     * @param path 出力先（空なら FlightRecorderOptions::dump_path）
+     * @param max_records 新しい方から数えた最大件数（0 なら全件）。それより古いレコードはリングに残る
+     * @return 書き出したレコード数
+     */
+    std::size_t dump_flight_recorder(std::string_view path = {}, std::size_t max_records = 0) {
+        auto* recorder = flight_recorder_.load(std::memory_order_acquire);
+        if (!recorder) {
+            return 0;
+        }
+        auto records = recorder->drain(max_records);
+        if (records.empty()) {
+            return 0;
+        }
+        if (path.empty()) {
+            path = recorder->options().dump_path;
+        }
+        if (!path.empty()) {
+            std::string content;
+            for (const auto& record : records) {
+                content += record.text;
             }
-        } else {
-            for (auto& [_, stream] : handles_) {
-                if (stream) {
-                    stream->flush();
-                }
+            write_file(path, content);
+            return records.size();
+        }
+        // 出力先ごとに古い順を保ってまとめ、1 パスにつき 1 回だけ書き込む
+        std::vector<logfunc_internal::FlightRecord> groups;
+        for (auto& record : records) {
+            auto it = std::find_if(groups.begin(), groups.end(),
+                                   [&](const auto& group) { return group.path == record.path; });
+            if (it == groups.end()) {
+                groups.push_back(std::move(record));
+            } else {
+                it->text += record.text;
+            }
+        }
+        for (const auto& group : groups) {
+            if (group.path.empty()) {
+                write_default_file(group.text);
+            } else {
+                write_file(group.path, group.text);
             }
         }
+        return records.size();
     }
-    
-    void close_all() {
-        std::lock_guard<std::mutex> lock(mtx_);
-        handles_.clear();
+
+    // === 構造化ログ ===
+
+    /**
+     * @brief 構造化ログの出力形式を設定（デフォルト: JSON Lines）
+     */
+    void set_structured_format(StructuredFormat format) {
+        structured_format_.store(format, std::memory_order_relaxed);
     }
 
-    void set_silent_mode(bool silent) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        silent_mode_ = silent;
+    StructuredFormat get_structured_format() const {
+        return structured_format_.load(std::memory_order_relaxed);
     }
-    
-    bool is_silent_mode() const {
-        std::lock_guard<std::mutex> lock(mtx_);
-        return silent_mode_;
+
+    /**
+     * @brief 構造化ログに ts（エポックからのミリ秒）を付けるか（デフォルト: 付ける）
+     */
+    void set_structured_timestamp(bool enabled) {
+        structured_timestamp_.store(enabled, std::memory_order_relaxed);
     }
 
-    // === ログ出力 ===
-    template<typename... Args>
-    void log(Args&&... args) {
-        std::ostringstream oss;
-        (oss << ... << std::forward<Args>(args));
-        write_atomic(log_file_path_, oss.str());
+    /**
+     * @brief メッセージとキー/値フィールドをデフォルトのログファイルへ1行で書き込む
+     *
+     * フィールドは kv(key, value) で指定する。整形はスレッドごとのバッファ上で行い、
+     * ロックは書き込みの間だけ保持する。
+     */
+    template<typename... Fields>
+    void log_kv(std::string_view message, const Fields&... fields) {
+        write_default(encode_kv(message, fields...));
     }
-    
-#ifdef HAS_STD_FORMAT
-    template<typename... Args>
-    void log_formatted(std::string_view format_str, Args&&... args) {
-        std::string content = std::vformat(format_str, std::make_format_args(args...));
-        write_atomic(log_file_path_, content);
+
+    template<typename... Fields>
+    void log_kv_to(std::string_view filepath, std::string_view message, const Fields&... fields) {
+        write_atomic(filepath, encode_kv(message, fields...));
     }
-#endif
 
-    template<typename... Args>
-    void log_to(std::string_view filepath, Args&&... args) {
-        std::ostringstream oss;
-        (oss << ... << std::forward<Args>(args));
-        write_atomic(filepath, oss.str());
+private:
+    template<typename... Fields>
+    std::string_view encode_kv(std::string_view message, const Fields&... fields) const {
+        static_assert((std::is_same_v<Fields, logfunc_internal::Field> && ...),
+                      "log_kv のフィールドは kv(key, value) で指定してください");
+        const logfunc_internal::Field* list[sizeof...(Fields) + 1] = {&fields..., nullptr};
+        std::int64_t ts = -1;
+        if (structured_timestamp_.load(std::memory_order_relaxed)) {
+            ts = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        std::string& buffer = logfunc_internal::format_buffer();
+        logfunc_internal::encode_structured(buffer, get_structured_format(), ts, message,
+                                            list, sizeof...(Fields));
+        return buffer;
     }
 
+public:
     // === 入力ファイル操作 ===
+    /**
+     * @brief 入力ファイルが無ければテンプレートを作る
+     *
+     * 存在確認と作成はパスごとに一度だけ行う（2 回目以降はパスの比較だけ）。
+     */
     void ensure_input_file_exists() {
         namespace fs = std::filesystem;
         std::string input_path;
         {
-            std::lock_guard<std::mutex> lock(mtx_);
+            auto lock = lock_mtx(LockSite::Config);
+            if (input_checked_path_ == input_file_path_) {
+                return;
+            }
             input_path = input_file_path_;
         }
-        
-        if (!fs::exists(input_path)) {
+
+        std::error_code ec;
+        if (!fs::exists(input_path, ec)) {
             std::ofstream file(input_path);
             if (file) {
                 file << "# Enter input values here (one per line)\n";
             }
         }
+        auto lock = lock_mtx(LockSite::Config);
+        input_checked_path_ = input_path;
     }
     
     InputFileCache& get_input_cache() {
@@ -787,7 +4367,7 @@ public:
      * @param enabled true: OSネイティブAPI使用, false: ポーリング使用
      */
     void set_event_driven_mode(bool enabled) {
-        std::lock_guard<std::mutex> lock(mtx_);
+        auto lock = lock_mtx(LockSite::Config);
         use_event_driven_ = enabled;
         if (file_watcher_) {
             file_watcher_->stop();
@@ -799,7 +4379,7 @@ public:
      * @brief イベント駆動モードが有効かどうか
      */
     bool is_event_driven_mode() const {
-        std::lock_guard<std::mutex> lock(mtx_);
+        auto lock = lock_mtx(LockSite::Config);
         return use_event_driven_;
     }
     
@@ -817,7 +4397,7 @@ public:
         std::string input_path;
         bool event_driven;
         {
-            std::lock_guard<std::mutex> lock(mtx_);
+            auto lock = lock_mtx(LockSite::Config);
             input_path = input_file_path_;
             event_driven = use_event_driven_;
         }
@@ -834,15 +4414,44 @@ public:
     }
 
 private:
+    // 入力ファイルから最初の値を読む（空行と # で始まる行は飛ばす）
+    template<typename T>
+    bool read_first_value(T& value, const std::string& input_path) {
+        std::ifstream file(input_path);
+        bump(&logfunc_internal::LoggerMetrics::Shard::input_reparses);
+        if (!file) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            line.erase(0, line.find_first_not_of(" \t\r\n"));
+            line.erase(line.find_last_not_of(" \t\r\n") + 1);
+            
+            if (!line.empty() && line[0] != '#') {
+                std::istringstream iss(line);
+                if (iss >> value) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
     // イベント駆動方式による入力読み取り
     template<typename T>
     void read_input_event_driven(T& value, const std::string& input_path) {
+        // 値が既にあれば監視は立ち上げない
+        if (read_first_value(value, input_path)) {
+            return;
+        }
+
         // ファイル監視を開始
         auto watcher = std::make_unique<logfunc_internal::FileWatcher>();
         std::atomic<bool> file_changed{true}; // 初回は読み込みを試みる
         
-        watcher->start(input_path, [&file_changed] {
+        watcher->start(input_path, [this, &file_changed] {
             file_changed.store(true);
+            bump(&logfunc_internal::LoggerMetrics::Shard::watcher_events);
         });
         
         bool value_read = false;
@@ -850,22 +4459,7 @@ private:
             if (file_changed.load()) {
                 file_changed.store(false);
                 
-                std::ifstream file(input_path);
-                if (file) {
-                    std::string line;
-                    while (std::getline(file, line)) {
-                        line.erase(0, line.find_first_not_of(" \t\r\n"));
-                        line.erase(line.find_last_not_of(" \t\r\n") + 1);
-                        
-                        if (!line.empty() && line[0] != '#') {
-                            std::istringstream iss(line);
-                            if (iss >> value) {
-                                value_read = true;
-                                break;
-                            }
-                        }
-                    }
-                }
+                value_read = read_first_value(value, input_path);
                 
                 if (!value_read) {
                     std::cout << "[File updated, reading...]\n";
@@ -888,22 +4482,7 @@ private:
         bool value_read = false;
         
         while (!value_read) {
-            std::ifstream file(input_path);
-            if (file) {
-                std::string line;
-                while (std::getline(file, line)) {
-                    line.erase(0, line.find_first_not_of(" \t\r\n"));
-                    line.erase(line.find_last_not_of(" \t\r\n") + 1);
-                    
-                    if (!line.empty() && line[0] != '#') {
-                        std::istringstream iss(line);
-                        if (iss >> value) {
-                            value_read = true;
-                            break;
-                        }
-                    }
-                }
-            }
+            value_read = read_first_value(value, input_path);
             
             if (!value_read) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -925,7 +4504,7 @@ public:
         
         std::string input_path;
         {
-            std::lock_guard<std::mutex> lock(mtx_);
+            auto lock = lock_mtx(LockSite::Config);
             input_path = input_file_path_;
         }
         
@@ -939,6 +4518,7 @@ public:
         }
         
         std::ifstream file(input_path);
+        bump(&logfunc_internal::LoggerMetrics::Shard::input_reparses);
         
         if (!file) {
             input_cache_.file_exists = false;
@@ -975,7 +4555,7 @@ public:
         std::string input_path;
         bool event_driven;
         {
-            std::lock_guard<std::mutex> lock(mtx_);
+            auto lock = lock_mtx(LockSite::Config);
             input_path = input_file_path_;
             event_driven = use_event_driven_;
         }
@@ -1001,11 +4581,17 @@ private:
     template<typename T>
     bool read_input_timeout_event_driven(T& value, const std::string& input_path, 
                                          std::chrono::milliseconds timeout) {
+        // 値が既にあれば監視は立ち上げない
+        if (try_read_input(value)) {
+            return true;
+        }
+
         auto watcher = std::make_unique<logfunc_internal::FileWatcher>();
         std::atomic<bool> file_changed{true};
         
-        watcher->start(input_path, [&file_changed] {
+        watcher->start(input_path, [this, &file_changed] {
             file_changed.store(true);
+            bump(&logfunc_internal::LoggerMetrics::Shard::watcher_events);
         });
         
         auto start_time = std::chrono::steady_clock::now();
@@ -1086,12 +4672,30 @@ public:
     
     // === 状態リセット（テスト用） ===
     void reset() {
-        std::lock_guard<std::mutex> lock(mtx_);
+        metrics_.reset();
+        auto lock = lock_mtx(LockSite::Other);
         handles_.clear();
+        default_handle_ = nullptr;
+        sink_factories_.clear();
+        time_indexes_.clear();
+        shared_append_.reset();
+        direct_io_.reset();
+        backend_.reset();
+        muted_.clear();
+        durability_.clear();
+        retired_path_stats_.clear();
         log_file_path_ = "log.txt";
         input_file_path_ = "in.txt";
+        input_checked_path_.clear();
         silent_mode_ = true;
         use_event_driven_ = true;
+        metrics_enabled_.store(true, std::memory_order_relaxed);
+        structured_format_.store(StructuredFormat::Json, std::memory_order_relaxed);
+        structured_timestamp_.store(true, std::memory_order_relaxed);
+        float_precision_.store(0, std::memory_order_relaxed);
+        dedup_repeats_.store(false, std::memory_order_relaxed);
+        flight_recorder_.store(nullptr, std::memory_order_release);
+        lock_profiler_.store(nullptr, std::memory_order_release);
         if (file_watcher_) {
             file_watcher_->stop();
             file_watcher_.reset();
@@ -1105,10 +4709,34 @@ public:
     }
 };
 
+namespace logfunc_internal {
+
+// デフォルト Logger の領域。関数内 static のガード判定を毎回通らないよう、
+// logfunc.h を含む翻訳単位ごとの DefaultLoggerInit（nifty counter）で
+// 最初の翻訳単位の静的初期化時に構築し、最後の翻訳単位の終了時に破棄する
+alignas(Logger) inline unsigned char default_logger_storage[sizeof(Logger)];
+inline int default_logger_users = 0;
+
+struct DefaultLoggerInit {
+    DefaultLoggerInit() {
+        if (default_logger_users++ == 0) {
+            new (default_logger_storage) Logger();
+        }
+    }
+    ~DefaultLoggerInit() {
+        if (--default_logger_users == 0) {
+            std::launder(reinterpret_cast<Logger*>(default_logger_storage))->~Logger();
+        }
+    }
+};
+
+static DefaultLoggerInit default_logger_init;
+
+} // namespace logfunc_internal
+
 // デフォルトのLoggerインスタンスを取得（後方互換性のため）
 inline Logger& get_default_logger() {
-    static Logger default_logger;
-    return default_logger;
+    return *std::launder(reinterpret_cast<Logger*>(logfunc_internal::default_logger_storage));
 }
 
 // ============================================================
@@ -1140,6 +4768,34 @@ inline void logto(std::string_view filepath, Args&&... args) {
     get_default_logger().log_to(filepath, std::forward<Args>(args)...);
 }
 
+// 構造化ログ（メッセージとキー/値フィールドを1行で書き込む）
+template<typename... Fields>
+inline void logkv(std::string_view message, const Fields&... fields) {
+    get_default_logger().log_kv(message, fields...);
+}
+
+template<typename... Fields>
+inline void logkv_to(std::string_view filepath, std::string_view message, const Fields&... fields) {
+    get_default_logger().log_kv_to(filepath, message, fields...);
+}
+
+inline void log_set_structured_format(Logger::StructuredFormat format) {
+    get_default_logger().set_structured_format(format);
+}
+
+inline void log_set_float_precision(int digits) {
+    get_default_logger().set_float_precision(digits);
+}
+
+// 複数パートのレコードをロックなしで組み立て、破棄時にまとめて書き込む
+inline Logger::RecordBuilder log_record() {
+    return get_default_logger().begin_record();
+}
+
+inline Logger::RecordBuilder log_record_to(std::string_view filepath) {
+    return get_default_logger().begin_record(filepath);
+}
+
 template<typename... Args>
 inline void logc(Args&&... args) {
     (std::cout << ... << std::forward<Args>(args));
@@ -1229,7 +4885,150 @@ inline bool log_has_native_file_watch_support() {
     return Logger::has_native_file_watch_support();
 }
 
+// メトリクス
+inline void log_set_metrics_enabled(bool enabled) {
+    get_default_logger().set_metrics_enabled(enabled);
+}
+
+inline Logger::MetricsSnapshot log_get_metrics() {
+    return get_default_logger().get_metrics();
+}
+
+inline void log_reset_metrics() {
+    get_default_logger().reset_metrics();
+}
+
+// ロック競合プロファイル
+inline void log_set_lock_profiling(bool enabled) {
+    get_default_logger().set_lock_profiling(enabled);
+}
+
+inline Logger::LockProfile log_get_lock_profile() {
+    return get_default_logger().get_lock_profile();
+}
+
+// 出力先
+inline void log_set_sink(std::string_view filepath, Logger::SinkFactory factory) {
+    get_default_logger().set_sink(filepath, std::move(factory));
+}
+
+inline void log_set_muted(std::string_view filepath, bool muted) {
+    get_default_logger().set_muted(filepath, muted);
+}
+
+// 複数プロセスからの追記
+inline void log_enable_shared_append(Logger::SharedAppendOptions options = {}) {
+    get_default_logger().enable_shared_append(options);
+}
+
+inline void log_disable_shared_append() {
+    get_default_logger().disable_shared_append();
+}
+
+// 永続性
+inline void log_set_durability(std::string_view filepath, Logger::DurabilityPolicy policy) {
+    get_default_logger().set_durability(filepath, policy);
+}
+
+inline Logger::CommitTicket log_commit_ticket(std::string_view filepath) {
+    return get_default_logger().commit_ticket(filepath);
+}
+
+// ページキャッシュを通さない出力
+inline void log_enable_direct_io(Logger::DirectIOOptions options = {}) {
+    get_default_logger().enable_direct_io(options);
+}
+
+inline void log_disable_direct_io() {
+    get_default_logger().disable_direct_io();
+}
+
+// 共有バックエンド
+inline void log_attach_backend(std::shared_ptr<Logger::SharedBackend> backend = Logger::SharedBackend::instance()) {
+    get_default_logger().attach_backend(std::move(backend));
+}
+
+inline void log_detach_backend() {
+    get_default_logger().detach_backend();
+}
+
+// 時刻インデックス
+inline void log_enable_time_index(std::string_view filepath, Logger::TimeIndexOptions options = {}) {
+    get_default_logger().enable_time_index(filepath, options);
+}
+
+inline void log_disable_time_index(std::string_view filepath) {
+    get_default_logger().disable_time_index(filepath);
+}
+
+/**
+ * @brief 時刻インデックスを使って [from, to] に書かれたレコードを読み出す
+ *
+ * 範囲の前後にはインデックスの間隔分だけ範囲外のレコードが含まれうる。
+ */
+inline std::string log_read_time_range(const std::string& filepath,
+                                       std::chrono::system_clock::time_point from,
+                                       std::chrono::system_clock::time_point to) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    return logfunc_internal::read_time_range(
+        filepath,
+        duration_cast<milliseconds>(from.time_since_epoch()).count(),
+        duration_cast<milliseconds>(to.time_since_epoch()).count());
+}
+
+// 重複抑制
+inline void log_set_dedup_repeats(bool enabled) {
+    get_default_logger().set_dedup_repeats(enabled);
+}
+
+// フライトレコーダー
+inline void log_enable_flight_recorder(Logger::FlightRecorderOptions options = {}) {
+    get_default_logger().enable_flight_recorder(std::move(options));
+}
+
+inline void log_disable_flight_recorder() {
+    get_default_logger().disable_flight_recorder();
+}
+
+inline std::size_t log_dump_flight_recorder(std::string_view filepath = {}, std::size_t max_records = 0) {
+    return get_default_logger().dump_flight_recorder(filepath, max_records);
+}
+
 // テスト用：デフォルトロガーの状態をリセット
 inline void log_reset() {
     get_default_logger().reset();
 }
+
+// ============================================================
+// サンプリング・レート制限マクロ
+//
+// 判定は引数の評価・整形より前に行われ、捨てた呼び出しでは引数は評価されない。
+// 捨てた回数は get_metrics().sampled_out に加算される。
+// ============================================================
+
+// この呼び出し箇所で n 回に1回だけ true
+#define LOGFUNC_EVERY_N(n) LOGFUNC_SITE_STATE(EveryN).should_log(n)
+
+// この呼び出し箇所で平均 per_second 回/秒（最大 burst 回連続）まで true
+#define LOGFUNC_RATE_LIMIT(per_second, burst) LOGFUNC_SITE_STATE(RateLimiter).allow(per_second, burst)
+
+#define LOGFF_EVERY_N(n, ...) do { \
+    if (LOGFUNC_EVERY_N(n)) logff(__VA_ARGS__); \
+    else get_default_logger().count_sampled_out(); \
+} while (0)
+
+#define LOGTO_EVERY_N(n, filepath, ...) do { \
+    if (LOGFUNC_EVERY_N(n)) logto(filepath, __VA_ARGS__); \
+    else get_default_logger().count_sampled_out(); \
+} while (0)
+
+#define LOGFF_RATE_LIMITED(per_second, burst, ...) do { \
+    if (LOGFUNC_RATE_LIMIT(per_second, burst)) logff(__VA_ARGS__); \
+    else get_default_logger().count_sampled_out(); \
+} while (0)
+
+#define LOGTO_RATE_LIMITED(per_second, burst, filepath, ...) do { \
+    if (LOGFUNC_RATE_LIMIT(per_second, burst)) logto(filepath, __VA_ARGS__); \
+    else get_default_logger().count_sampled_out(); \
+} while (0)
@@ -0,0 +1,530 @@
+#pragma once
+
+// ============================================================
+// logfunc 圧縮シンク
+//
+// Logger::set_sink() と組み合わせて、ログファイルを書き込み側で
+// ストリーミング圧縮する。
+//
+//   gzip : zlib を使用（常に有効。リンク時に -lz）
+//   zstd : LOGFUNC_WITH_ZSTD を定義した場合（-lzstd）
+//   LZ4  : LOGFUNC_WITH_LZ4 を定義した場合（-llz4、LZ4 frame 形式）
+//
+// 一定量（CompressionOptions::flush_bytes）ごと、および flush() のたびに
+// 圧縮ストリームを区切るため、書き込み途中のファイルもその位置まで展開できる。
+// CompressionOptions::threads を指定すると、区切ったブロックを独立に並列圧縮する。
+// ============================================================
+
+#include "logfunc.h"
+
+#include <deque>
+
+#include <zlib.h>
+#ifdef LOGFUNC_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LOGFUNC_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+/**
+ * @brief 圧縮形式
+ */
+enum class LogCompression {
+    Gzip,
+    Zstd,
+    Lz4
+};
+
+/**
+ * @brief 圧縮シンクの設定
+ */
+struct CompressionOptions {
+    LogCompression codec = LogCompression::Gzip;
+    int level = -1;                        // -1 は各形式の既定値
+    std::size_t flush_bytes = 64 * 1024;   // この量の入力ごとにストリームを区切る
+    unsigned threads = 0;                  // 1 以上で flush_bytes ごとのブロックを並列に圧縮する
+};
+
+namespace logfunc_internal {
+
+/**
+ * @brief gzip（zlib）のストリーミング圧縮器
+ */
+class GzipEncoder {
+public:
+    explicit GzipEncoder(int level) {
+        int z_level = level < 0 ? Z_DEFAULT_COMPRESSION : (level > 9 ? 9 : level);
+        // windowBits に 16 を加えると gzip ヘッダとトレーラーを付ける
+        if (deflateInit2(&stream_, z_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("deflateInit2 failed");
+        }
+    }
+
+    ~GzipEncoder() {
+        deflateEnd(&stream_);
+    }
+
+    GzipEncoder(const GzipEncoder&) = delete;
+    GzipEncoder& operator=(const GzipEncoder&) = delete;
+
+    void update(std::string_view in, std::string& out) {
+        run(in, Z_NO_FLUSH, out);
+    }
+
+    // ここまでの入力をバイト境界で区切って出力する（Z_SYNC_FLUSH）
+    void flush(std::string& out) {
+        run({}, Z_SYNC_FLUSH, out);
+    }
+
+    void finish(std::string& out) {
+        run({}, Z_FINISH, out);
+    }
+
+    // finish() 後に次のメンバーを始める
+    void reset() {
+        deflateReset(&stream_);
+    }
+
+private:
+    void run(std::string_view in, int mode, std::string& out) {
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        stream_.avail_in = static_cast<uInt>(in.size());
+        for (;;) {
+            std::size_t old_size = out.size();
+            out.resize(old_size + kChunk);
+            stream_.next_out = reinterpret_cast<Bytef*>(&out[old_size]);
+            stream_.avail_out = static_cast<uInt>(kChunk);
+            int ret = deflate(&stream_, mode);
+            out.resize(old_size + (kChunk - stream_.avail_out));
+            if (ret == Z_STREAM_ERROR) {
+                throw std::runtime_error("deflate failed");
+            }
+            // 出力バッファに空きが残れば、この mode で出すべきものは出し切っている
+            if (stream_.avail_out != 0 || ret == Z_STREAM_END) {
+                break;
+            }
+        }
+    }
+
+    static constexpr std::size_t kChunk = 64 * 1024;
+    z_stream stream_{};
+};
+
+#ifdef LOGFUNC_WITH_ZSTD
+/**
+ * @brief zstd のストリーミング圧縮器
+ */
+class ZstdEncoder {
+public:
+    explicit ZstdEncoder(int level) : cctx_(ZSTD_createCCtx()) {
+        if (!cctx_) {
+            throw std::runtime_error("ZSTD_createCCtx failed");
+        }
+        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+    }
+
+    ~ZstdEncoder() {
+        ZSTD_freeCCtx(cctx_);
+    }
+
+    ZstdEncoder(const ZstdEncoder&) = delete;
+    ZstdEncoder& operator=(const ZstdEncoder&) = delete;
+
+    void update(std::string_view in, std::string& out) {
+        run(in, ZSTD_e_continue, out);
+    }
+
+    void flush(std::string& out) {
+        run({}, ZSTD_e_flush, out);
+    }
+
+    void finish(std::string& out) {
+        run({}, ZSTD_e_end, out);
+    }
+
+    void reset() {
+        ZSTD_CCtx_reset(cctx_, ZSTD_reset_session_only);
+    }
+
+private:
+    void run(std::string_view in, ZSTD_EndDirective mode, std::string& out) {
+        ZSTD_inBuffer input{in.data(), in.size(), 0};
+        const std::size_t chunk = ZSTD_CStreamOutSize();
+        for (;;) {
+            std::size_t old_size = out.size();
+            out.resize(old_size + chunk);
+            ZSTD_outBuffer output{&out[old_size], chunk, 0};
+            std::size_t remaining = ZSTD_compressStream2(cctx_, &output, &input, mode);
+            out.resize(old_size + output.pos);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(remaining));
+            }
+            bool done = mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0;
+            if (done) {
+                break;
+            }
+        }
+    }
+
+    ZSTD_CCtx* cctx_;
+};
+#endif // LOGFUNC_WITH_ZSTD
+
+#ifdef LOGFUNC_WITH_LZ4
+/**
+ * @brief LZ4 frame 形式のストリーミング圧縮器
+ */
+class Lz4Encoder {
+public:
+    explicit Lz4Encoder(int level) {
+        if (LZ4F_isError(LZ4F_createCompressionContext(&ctx_, LZ4F_VERSION))) {
+            throw std::runtime_error("LZ4F_createCompressionContext failed");
+        }
+        prefs_.compressionLevel = level < 0 ? 0 : level;
+    }
+
+    ~Lz4Encoder() {
+        LZ4F_freeCompressionContext(ctx_);
+    }
+
+    Lz4Encoder(const Lz4Encoder&) = delete;
+    Lz4Encoder& operator=(const Lz4Encoder&) = delete;
+
+    void update(std::string_view in, std::string& out) {
+        begin(out);
+        std::size_t bound = LZ4F_compressBound(in.size(), &prefs_);
+        std::size_t old_size = out.size();
+        out.resize(old_size + bound);
+        std::size_t n = LZ4F_compressUpdate(ctx_, &out[old_size], bound, in.data(), in.size(), nullptr);
+        check(n, old_size, out);
+    }
+
+    void flush(std::string& out) {
+        begin(out);
+        std::size_t bound = LZ4F_compressBound(0, &prefs_);
+        std::size_t old_size = out.size();
+        out.resize(old_size + bound);
+        check(LZ4F_flush(ctx_, &out[old_size], bound, nullptr), old_size, out);
+    }
+
+    void finish(std::string& out) {
+        begin(out);
+        std::size_t bound = LZ4F_compressBound(0, &prefs_);
+        std::size_t old_size = out.size();
+        out.resize(old_size + bound);
+        check(LZ4F_compressEnd(ctx_, &out[old_size], bound, nullptr), old_size, out);
+    }
+
+    void reset() {
+        started_ = false;
+    }
+
+private:
+    // フレームヘッダは最初の出力時に書く
+    void begin(std::string& out) {
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        std::size_t old_size = out.size();
+        out.resize(old_size + LZ4F_HEADER_SIZE_MAX);
+        check(LZ4F_compressBegin(ctx_, &out[old_size], LZ4F_HEADER_SIZE_MAX, &prefs_), old_size, out);
+    }
+
+    static void check(std::size_t result, std::size_t old_size, std::string& out) {
+        if (LZ4F_isError(result)) {
+            out.resize(old_size);
+            throw std::runtime_error(std::string("lz4: ") + LZ4F_getErrorName(result));
+        }
+        out.resize(old_size + result);
+    }
+
+    LZ4F_cctx* ctx_ = nullptr;
+    LZ4F_preferences_t prefs_{};
+    bool started_ = false;
+};
+#endif // LOGFUNC_WITH_LZ4
+
+/**
+ * @brief 圧縮形式ごとの圧縮器を同じインターフェースで扱うためのラッパー
+ */
+class Encoder {
+public:
+    Encoder(LogCompression codec, int level) {
+        switch (codec) {
+            case LogCompression::Gzip:
+                impl_ = std::make_unique<Impl<GzipEncoder>>(level);
+                break;
+#ifdef LOGFUNC_WITH_ZSTD
+            case LogCompression::Zstd:
+                impl_ = std::make_unique<Impl<ZstdEncoder>>(level);
+                break;
+#endif
+#ifdef LOGFUNC_WITH_LZ4
+            case LogCompression::Lz4:
+                impl_ = std::make_unique<Impl<Lz4Encoder>>(level);
+                break;
+#endif
+            default:
+                throw std::runtime_error("compression codec not available in this build");
+        }
+    }
+
+    void update(std::string_view in, std::string& out) { impl_->update(in, out); }
+    void flush(std::string& out) { impl_->flush(out); }
+    void finish(std::string& out) { impl_->finish(out); }
+    void reset() { impl_->reset(); }
+
+private:
+    struct Base {
+        virtual ~Base() = default;
+        virtual void update(std::string_view in, std::string& out) = 0;
+        virtual void flush(std::string& out) = 0;
+        virtual void finish(std::string& out) = 0;
+        virtual void reset() = 0;
+    };
+
+    template<typename E>
+    struct Impl : Base {
+        explicit Impl(int level) : encoder(level) {}
+        void update(std::string_view in, std::string& out) override { encoder.update(in, out); }
+        void flush(std::string& out) override { encoder.flush(out); }
+        void finish(std::string& out) override { encoder.finish(out); }
+        void reset() override { encoder.reset(); }
+        E encoder;
+    };
+
+    std::unique_ptr<Base> impl_;
+};
+
+/**
+ * @brief 書き込みながら圧縮してファイルへ追記するシンク
+ *
+ * 1つのシンク（= ファイルを開いてから閉じるまで）が 1 つの gzip メンバー /
+ * zstd フレーム / LZ4 フレームになる。再オープン時は新しいメンバーとして追記されるが、
+ * いずれの形式も連結したファイルをそのまま展開できる。
+ */
+class CompressingSink : public LogSink {
+public:
+    CompressingSink(const std::string& path, const CompressionOptions& options)
+        : encoder_(options.codec, options.level),
+          flush_bytes_(options.flush_bytes),
+          file_(path, std::ios::binary | std::ios::app) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+    }
+
+    ~CompressingSink() override {
+        try {
+            encoder_.finish(out_);
+            write_out();
+        } catch (const std::exception& e) {
+            std::cerr << "[logfunc] compression error: " << e.what() << std::endl;
+        }
+    }
+
+    void write(std::string_view data) override {
+        encoder_.update(data, out_);
+        pending_ += data.size();
+        if (pending_ >= flush_bytes_) {
+            boundary();
+        } else if (out_.size() >= kWriteThreshold) {
+            write_out();
+        }
+    }
+
+    void flush() override {
+        if (pending_ > 0) {
+            boundary();
+        }
+    }
+
+private:
+    // 圧縮ストリームを区切り、ここまでの内容をファイルから展開できるようにする
+    void boundary() {
+        encoder_.flush(out_);
+        pending_ = 0;
+        write_out();
+        file_.flush();
+    }
+
+    void write_out() {
+        if (!out_.empty()) {
+            file_.write(out_.data(), static_cast<std::streamsize>(out_.size()));
+            out_.clear();
+        }
+    }
+
+    static constexpr std::size_t kWriteThreshold = 256 * 1024;
+
+    Encoder encoder_;
+    std::size_t flush_bytes_;
+    std::size_t pending_ = 0;   // 最後の区切り以降の入力バイト数
+    std::string out_;           // まだファイルに書いていない圧縮データ
+    std::ofstream file_;
+};
+
+/**
+ * @brief 入力を独立したブロックに分け、ワーカースレッドで並列に圧縮するシンク
+ *
+ * 各ブロック（flush_bytes ごと、または flush() までの入力）はそれぞれ完結した
+ * gzip メンバー / zstd フレーム / LZ4 フレームになり、入力順にファイルへ書かれる。
+ * 出力は CompressingSink と同じく標準のツールでそのまま展開できる。
+ * 圧縮待ちのブロックが threads * 2 個を超えると write() は空きを待つ。
+ */
+class ParallelCompressingSink : public LogSink {
+public:
+    ParallelCompressingSink(const std::string& path, const CompressionOptions& options)
+        : block_bytes_(options.flush_bytes > 0 ? options.flush_bytes : 1),
+          max_in_flight_(static_cast<std::size_t>(options.threads) * 2),
+          file_(path, std::ios::binary | std::ios::app) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        // 利用できない形式ならここで例外にする
+        Encoder probe(options.codec, options.level);
+        for (unsigned i = 0; i < options.threads; ++i) {
+            workers_.emplace_back([this, options] { worker_loop(options); });
+        }
+    }
+
+    ~ParallelCompressingSink() override {
+        submit_block();
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void write(std::string_view data) override {
+        block_.append(data.data(), data.size());
+        if (block_.size() >= block_bytes_) {
+            submit_block();
+        }
+    }
+
+    // 未送信の入力をブロックにして、書き込み済みになるまで待つ
+    void flush() override {
+        submit_block();
+        std::unique_lock<std::mutex> lock(mtx_);
+        done_cv_.wait(lock, [this] { return next_write_ == next_seq_; });
+        file_.flush();
+    }
+
+private:
+    struct Block {
+        std::uint64_t seq;
+        std::string data;
+    };
+
+    void submit_block() {
+        if (block_.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        done_cv_.wait(lock, [this] { return next_seq_ - next_write_ < max_in_flight_; });
+        queue_.push_back(Block{next_seq_++, std::move(block_)});
+        lock.unlock();
+        work_cv_.notify_one();
+        block_.clear();
+        block_.reserve(block_bytes_);
+    }
+
+    void worker_loop(const CompressionOptions& options) {
+        Encoder encoder(options.codec, options.level);
+        std::string out;
+        for (;;) {
+            Block block;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                block = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            out.clear();
+            try {
+                encoder.update(block.data, out);
+                encoder.finish(out);
+                encoder.reset();
+            } catch (const std::exception& e) {
+                std::cerr << "[logfunc] compression error: " << e.what() << std::endl;
+                out.clear();
+                encoder = Encoder(options.codec, options.level);
+            }
+
+            std::unique_lock<std::mutex> lock(mtx_);
+            ready_.emplace(block.seq, std::move(out));
+            out = std::string();
+            // 自分の番までのブロックが揃っていれば、順番にファイルへ書く
+            while (!ready_.empty() && ready_.begin()->first == next_write_) {
+                const std::string& data = ready_.begin()->second;
+                file_.write(data.data(), static_cast<std::streamsize>(data.size()));
+                ready_.erase(ready_.begin());
+                next_write_ += 1;
+            }
+            lock.unlock();
+            done_cv_.notify_all();
+        }
+    }
+
+    const std::size_t block_bytes_;
+    const std::size_t max_in_flight_;
+    std::string block_;                                // 書き込み中のブロック（ロガーのミューテックスで保護）
+
+    std::mutex mtx_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<Block> queue_;                          // 圧縮待ち
+    std::map<std::uint64_t, std::string> ready_;       // 圧縮済みで前のブロックを待っているもの
+    std::uint64_t next_seq_ = 0;
+    std::uint64_t next_write_ = 0;
+    bool stop_ = false;
+    std::ofstream file_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace logfunc_internal
+
+/**
+ * @brief この環境で使える圧縮形式か
+ */
+inline bool compression_available(LogCompression codec) {
+    switch (codec) {
+        case LogCompression::Gzip: return true;
+#ifdef LOGFUNC_WITH_ZSTD
+        case LogCompression::Zstd: return true;
+#endif
+#ifdef LOGFUNC_WITH_LZ4
+        case LogCompression::Lz4: return true;
+#endif
+        default: return false;
+    }
+}
+
+/**
+ * @brief 圧縮シンクのファクトリを作る（Logger::set_sink / log_set_sink に渡す）
+ * @code
+ * log_set_sink("app.log.gz", compressed_sink({LogCompression::Gzip, 6}));
+ * @endcode
+ */
+inline Logger::SinkFactory compressed_sink(CompressionOptions options = {}) {
+    if (!compression_available(options.codec)) {
+        throw std::runtime_error("compression codec not available in this build");
+    }
+    return [options](const std::string& path) -> std::unique_ptr<Logger::Sink> {
+        if (options.threads > 0) {
+            return std::make_unique<logfunc_internal::ParallelCompressingSink>(path, options);
+        }
+        return std::make_unique<logfunc_internal::CompressingSink>(path, options);
+    };
+}
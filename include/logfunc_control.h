@@ -0,0 +1,251 @@
+#pragma once
+
+// ============================================================
+// logfunc 制御ファイル（実行中のレベル・出力先の切り替え）
+//
+// 小さなテキストファイル（既定は log.ctl）を FileWatcher で監視し、保存されるたびに
+// 名前付きロガーのレベル・出力先、パスごとの書き込みの停止、flush / ダンプを反映する。
+// ファイルは「望む状態」を表し、行を消した設定は元（親から引き継ぐ状態）に戻る。
+// 1 行でも誤りがあればその版は反映せず、直前の状態を保つ。
+// ログを書く側の処理は増えない（判定は名前付きロガーの atomic の読み込みのまま）。
+//
+//   # log.ctl
+//   level net.http debug        # net.http とその子孫を Debug に
+//   level * warn                # ルート
+//   target db db.log            # db の出力先
+//   mute trace.log              # trace.log への書き込みを止める
+//   flush                       # 新しく現れた行のときだけ実行する
+//   dump incident.txt 1000      # フライトレコーダーを書き出す
+//
+//   LogControl control;         // デフォルト Logger を操作する
+//   control.start("log.ctl");
+// ============================================================
+
+#include "logfunc.h"
+#include "logfunc_named.h"
+
+#include <map>
+#include <set>
+
+/**
+ * @brief 制御ファイルを監視して設定を反映する
+ */
+class LogControl {
+public:
+    explicit LogControl(Logger& logger = get_default_logger()) : logger_(logger) {}
+
+    ~LogControl() {
+        stop();
+    }
+
+    LogControl(const LogControl&) = delete;
+    LogControl& operator=(const LogControl&) = delete;
+
+    /**
+     * @brief path の現在の内容を反映し、以後の保存を監視する
+     * @return 最初の反映に成功したか（ファイルが無い場合も true。作られた時点で反映する）
+     */
+    bool start(const std::string& path = "log.ctl") {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            path_ = path;
+            last_content_.reset();
+        }
+        // 監視を先に始め、読み込みとの間の保存を取りこぼさない
+        watcher_.start(path, [this] { reload(); }, true);
+        return reload();
+    }
+
+    void stop() {
+        watcher_.stop();
+    }
+
+    /**
+     * @brief 制御ファイルを読み直して反映する（内容が前回と同じなら何もしない）
+     * @return 反映できたか、変化がなかった場合 true。誤りがあれば false（last_error() に理由）
+     */
+    bool reload() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::string content;
+        {
+            std::ifstream file(path_, std::ios::binary);
+            if (!file) {
+                return true;
+            }
+            content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        if (last_content_ && *last_content_ == content) {
+            return last_error_.empty();
+        }
+        last_content_ = content;
+
+        State next;
+        std::string error;
+        if (!parse(content, next, error)) {
+            last_error_ = path_ + ":" + error;
+            std::cerr << "[logfunc] Warning: " << last_error_ << " (control file not applied)" << std::endl;
+            return false;
+        }
+        last_error_.clear();
+        apply(next);
+        state_ = std::move(next);
+        applied_ += 1;
+        return true;
+    }
+
+    /**
+     * @brief 直近の読み込みで見つかった誤り（無ければ空）
+     */
+    std::string last_error() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return last_error_;
+    }
+
+    /**
+     * @brief 反映した版の数
+     */
+    std::uint64_t applied_count() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return applied_;
+    }
+
+private:
+    // ファイル 1 版分の設定
+    struct State {
+        std::map<std::string, LogLevel> levels;
+        std::map<std::string, std::string> targets;
+        std::set<std::string> muted;
+        std::set<std::string> actions;   // flush / dump の行（正規化したもの）
+    };
+
+    static std::string logger_name(const std::string& word) {
+        return word == "*" ? std::string() : word;
+    }
+
+    static bool parse(const std::string& content, State& state, std::string& error) {
+        std::istringstream lines(content);
+        std::string line;
+        for (int number = 1; std::getline(lines, line); ++number) {
+            auto hash = line.find('#');
+            if (hash != std::string::npos) {
+                line.erase(hash);
+            }
+            std::istringstream words(line);
+            std::vector<std::string> args;
+            for (std::string word; words >> word;) {
+                args.push_back(word);
+            }
+            if (args.empty()) {
+                continue;
+            }
+            auto fail = [&](const std::string& message) {
+                error = std::to_string(number) + ": " + message;
+                return false;
+            };
+            const std::string& command = args[0];
+            if (command == "level") {
+                LogLevel level = LogLevel::Info;
+                if (args.size() != 3) return fail("usage: level <logger|*> <level>");
+                if (!parse_log_level(args[2], level)) return fail("unknown level '" + args[2] + "'");
+                state.levels[logger_name(args[1])] = level;
+            } else if (command == "target") {
+                if (args.size() != 3) return fail("usage: target <logger|*> <path>");
+                state.targets[logger_name(args[1])] = args[2];
+            } else if (command == "mute") {
+                if (args.size() != 2) return fail("usage: mute <path>");
+                state.muted.insert(args[1]);
+            } else if (command == "flush") {
+                if (args.size() > 2) return fail("usage: flush [tag]");
+                state.actions.insert(join(args));
+            } else if (command == "dump") {
+                if (args.size() < 2 || args.size() > 4) return fail("usage: dump <path> [max_records] [tag]");
+                // 3 語目が数でなければタグとみなす（max_records は省略）
+                bool has_count = args.size() >= 3 && is_number(args[2]);
+                if (args.size() == 4 && !has_count) return fail("max_records must be a number");
+                auto action = args;
+                if (args.size() == 3 && !has_count) action.insert(action.begin() + 2, "0");
+                state.actions.insert(join(action));
+            } else {
+                return fail("unknown command '" + command + "'");
+            }
+        }
+        return true;
+    }
+
+    static bool is_number(const std::string& word) {
+        return !word.empty() && word.find_first_not_of("0123456789") == std::string::npos;
+    }
+
+    static std::string join(const std::vector<std::string>& args) {
+        std::string out;
+        for (const auto& arg : args) {
+            if (!out.empty()) out += ' ';
+            out += arg;
+        }
+        return out;
+    }
+
+    // 前の版との差分を反映する。消えた設定は元に戻す
+    void apply(const State& next) {
+        auto& registry = logfunc_internal::NamedLoggerRegistry::instance();
+        std::vector<std::pair<std::string, std::optional<LogLevel>>> levels;
+        for (const auto& [name, level] : state_.levels) {
+            if (next.levels.count(name) == 0) levels.emplace_back(name, std::nullopt);
+        }
+        for (const auto& [name, level] : next.levels) {
+            levels.emplace_back(name, level);
+        }
+        std::vector<std::pair<std::string, const logfunc_internal::NamedTarget*>> targets;
+        for (const auto& [name, path] : state_.targets) {
+            if (next.targets.count(name) == 0) targets.emplace_back(name, nullptr);
+        }
+        for (const auto& [name, path] : next.targets) {
+            targets.emplace_back(name, registry.intern(&logger_, path));
+        }
+        std::vector<std::pair<std::string, bool>> muted;
+        for (const auto& path : state_.muted) {
+            if (next.muted.count(path) == 0) muted.emplace_back(path, false);
+        }
+        for (const auto& path : next.muted) {
+            if (state_.muted.count(path) == 0) muted.emplace_back(path, true);
+        }
+        // レベル・出力先と書き込みの停止を 1 回の反映で切り替える
+        registry.apply(levels, targets, [&] {
+            if (!muted.empty()) logger_.set_muted(muted);
+        });
+
+        // flush / dump は前の版に無かった行だけ実行する
+        for (const auto& action : next.actions) {
+            if (state_.actions.count(action) != 0) {
+                continue;
+            }
+            std::istringstream words(action);
+            std::string command, path;
+            std::size_t max_records = 0;
+            words >> command >> path >> max_records;
+            if (command == "flush") {
+                logger_.flush();
+            } else {
+                logger_.dump_flight_recorder(path, max_records);
+            }
+        }
+    }
+
+    Logger& logger_;
+    logfunc_internal::FileWatcher watcher_;
+    mutable std::mutex mtx_;
+    std::string path_;
+    std::optional<std::string> last_content_;
+    std::string last_error_;
+    State state_;
+    std::uint64_t applied_ = 0;
+};
+
+/**
+ * @brief デフォルト Logger 用の制御ファイルの監視を始める（2 回目以降は監視するファイルを切り替える）
+ */
+inline bool log_watch_control_file(const std::string& path = "log.ctl") {
+    static LogControl control;
+    return control.start(path);
+}
@@ -58,7 +58,7 @@ public:
     std::string get_input_path() const;
 
     // ファイルキャッシュ操作
-    std::ofstream& get_or_open(std::string_view path);
+    std::ostream& get_or_open(std::string_view path);
     void write_atomic(std::string_view path, const std::string& content);
     void flush(std::string_view path = {});
     void close_all();
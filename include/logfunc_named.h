@@ -0,0 +1,333 @@
+#pragma once
+
+// ============================================================
+// logfunc 名前付きロガー（モジュールごとのレベルと出力先）
+//
+// "net"、"net.http" のようにドットで区切った名前でロガーを階層化する。
+// レベルと出力先は、自分で設定していなければ親から引き継ぐ。設定の変更は
+// 子孫に伝えておくので、呼び出し側の判定は relaxed な atomic の読み込み 1 回で済む。
+// ロガーは一度作ると消えないため、参照は静的初期化のときに 1 回だけ取ればよい。
+//
+//   static NamedLogger& net_log = get_logger("net");
+//   LOGN(net_log, Debug, "connected fd=", fd, "\n");   // 無効なら引数も評価しない
+//   log_set_level("net", LogLevel::Debug);            // 実行中に切り替える
+// ============================================================
+
+#include "logfunc.h"
+
+#include <cctype>
+#include <deque>
+#include <map>
+
+/**
+ * @brief ログのレベル（Off はすべて捨てる）
+ */
+enum class LogLevel : std::uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Fatal,
+    Off
+};
+
+inline std::string_view log_level_name(LogLevel level) {
+    static constexpr std::string_view names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OFF"};
+    auto index = static_cast<std::size_t>(level);
+    return index < std::size(names) ? names[index] : "?";
+}
+
+/**
+ * @brief レベル名（大文字小文字は区別しない）を LogLevel にする
+ */
+inline bool parse_log_level(std::string_view text, LogLevel& level) {
+    for (std::uint8_t i = 0; i <= static_cast<std::uint8_t>(LogLevel::Off); ++i) {
+        auto name = log_level_name(static_cast<LogLevel>(i));
+        if (name.size() == text.size() &&
+            std::equal(name.begin(), name.end(), text.begin(), [](char a, char b) {
+                return a == std::toupper(static_cast<unsigned char>(b));
+            })) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+class NamedLogger;
+
+namespace logfunc_internal {
+
+/**
+ * @brief 名前付きロガーの出力先（logger が nullptr ならデフォルト Logger、path が空ならその既定のパス）
+ *
+ * 出力先はレジストリが持ち続けるので、ロガーは生のポインタを atomic に保持できる。
+ */
+struct NamedTarget {
+    Logger* logger = nullptr;
+    std::string path;
+};
+
+class NamedLoggerRegistry;
+
+} // namespace logfunc_internal
+
+/**
+ * @brief 名前付きロガー（get_logger で取得する）
+ */
+class NamedLogger {
+public:
+    NamedLogger(const NamedLogger&) = delete;
+    NamedLogger& operator=(const NamedLogger&) = delete;
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    NamedLogger* parent() const {
+        return parent_;
+    }
+
+    /**
+     * @brief level のレコードを書くか（relaxed な atomic の読み込み 1 回）
+     */
+    bool enabled(LogLevel level) const {
+        return static_cast<std::uint8_t>(level) >= threshold_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 親から引き継いだ分も含めた現在のレベル
+     */
+    LogLevel level() const {
+        return static_cast<LogLevel>(threshold_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief "[LEVEL] name: " を付けて 1 レコード書く（level が無効なら何もしない）
+     */
+    template<typename... Args>
+    void log(LogLevel level, Args&&... args) {
+        if (!enabled(level)) {
+            return;
+        }
+        const auto* target = target_.load(std::memory_order_acquire);
+        Logger& logger = target->logger ? *target->logger : get_default_logger();
+        if (target->path.empty()) {
+            logger.log("[", log_level_name(level), "] ", name_, ": ", std::forward<Args>(args)...);
+        } else {
+            logger.log_to(target->path, "[", log_level_name(level), "] ", name_, ": ", std::forward<Args>(args)...);
+        }
+    }
+
+    template<typename... Args> void trace(Args&&... args) { log(LogLevel::Trace, std::forward<Args>(args)...); }
+    template<typename... Args> void debug(Args&&... args) { log(LogLevel::Debug, std::forward<Args>(args)...); }
+    template<typename... Args> void info(Args&&... args) { log(LogLevel::Info, std::forward<Args>(args)...); }
+    template<typename... Args> void warn(Args&&... args) { log(LogLevel::Warn, std::forward<Args>(args)...); }
+    template<typename... Args> void error(Args&&... args) { log(LogLevel::Error, std::forward<Args>(args)...); }
+    template<typename... Args> void fatal(Args&&... args) { log(LogLevel::Fatal, std::forward<Args>(args)...); }
+
+    // 以下の設定は子孫にも伝わる（子孫が自分で設定している項目は除く）
+    void set_level(LogLevel level);
+    void clear_level();
+
+    /**
+     * @brief 出力先を設定する（logger を省略するとデフォルト Logger、path が空ならその既定のパス）
+     *
+     * logger はこのロガーから書く間は生存している必要がある。
+     */
+    void set_target(std::string_view path, Logger* logger = nullptr);
+    void clear_target();
+
+private:
+    friend class logfunc_internal::NamedLoggerRegistry;
+
+    NamedLogger(std::string name, NamedLogger* parent) : name_(std::move(name)), parent_(parent) {}
+
+    std::string name_;
+    NamedLogger* parent_;
+
+    // 以下の 4 つはレジストリのミューテックスで保護する
+    std::vector<NamedLogger*> children_;
+    std::optional<LogLevel> own_level_;
+    const logfunc_internal::NamedTarget* own_target_ = nullptr;
+
+    std::atomic<std::uint8_t> threshold_{static_cast<std::uint8_t>(LogLevel::Info)};
+    std::atomic<const logfunc_internal::NamedTarget*> target_{nullptr};
+};
+
+namespace logfunc_internal {
+
+/**
+ * @brief 名前付きロガーの表
+ *
+ * ロガーと出力先は破棄しない。静的破棄の途中で書くロガーがあっても参照が有効なよう、
+ * 表そのものも破棄しない。
+ */
+class NamedLoggerRegistry {
+public:
+    static NamedLoggerRegistry& instance() {
+        static NamedLoggerRegistry* registry = new NamedLoggerRegistry();
+        return *registry;
+    }
+
+    NamedLogger& get(std::string_view name) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return get_locked(name);
+    }
+
+    void set_level(NamedLogger& logger, std::optional<LogLevel> level) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        logger.own_level_ = level;
+        refresh_locked(logger);
+    }
+
+    void set_target(NamedLogger& logger, const NamedTarget* target) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        logger.own_target_ = target;
+        refresh_locked(logger);
+    }
+
+    /**
+     * @brief 複数のロガーのレベルと出力先を 1 回のロックで変える
+     *
+     * nullopt / nullptr は親から引き継ぐ状態に戻す（ルートは既定値に戻す）。
+     * with_lock は同じロックの中で、新しい実効値を公開する直前に呼ぶ
+     * （Logger 側の設定を一緒に切り替える場合に使う）。
+     */
+    void apply(const std::vector<std::pair<std::string, std::optional<LogLevel>>>& levels,
+               const std::vector<std::pair<std::string, const NamedTarget*>>& targets,
+               const std::function<void()>& with_lock = {}) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto& [name, level] : levels) {
+            NamedLogger& logger = get_locked(name);
+            logger.own_level_ = logger.parent_ ? level : level.value_or(LogLevel::Info);
+        }
+        for (const auto& [name, target] : targets) {
+            NamedLogger& logger = get_locked(name);
+            logger.own_target_ = logger.parent_ || target ? target : &targets_.front();
+        }
+        if (with_lock) {
+            with_lock();
+        }
+        refresh_locked(*loggers_.at(""));
+    }
+
+    // 同じ出力先は 1 つにまとめる
+    const NamedTarget* intern(Logger* logger, std::string_view path) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto& target : targets_) {
+            if (target.logger == logger && target.path == path) {
+                return &target;
+            }
+        }
+        targets_.push_back(NamedTarget{logger, std::string(path)});
+        return &targets_.back();
+    }
+
+    /**
+     * @brief 作成済みのロガーの名前（親が先に並ぶ）
+     */
+    std::vector<std::string> names() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::vector<std::string> out;
+        for (const auto& [name, logger] : loggers_) {
+            out.push_back(name);
+        }
+        return out;
+    }
+
+private:
+    NamedLoggerRegistry() {
+        targets_.emplace_back();
+        auto root = std::unique_ptr<NamedLogger>(new NamedLogger("", nullptr));
+        root->own_level_ = LogLevel::Info;
+        root->own_target_ = &targets_.front();
+        root->target_.store(&targets_.front(), std::memory_order_release);
+        loggers_.emplace("", std::move(root));
+    }
+
+    NamedLogger& get_locked(std::string_view name) {
+        auto it = loggers_.find(name);
+        if (it != loggers_.end()) {
+            return *it->second;
+        }
+        auto dot = name.rfind('.');
+        NamedLogger& parent = get_locked(dot == std::string_view::npos ? std::string_view{} : name.substr(0, dot));
+        auto logger = std::unique_ptr<NamedLogger>(new NamedLogger(std::string(name), &parent));
+        NamedLogger& ref = *logger;
+        parent.children_.push_back(&ref);
+        loggers_.emplace(ref.name_, std::move(logger));
+        refresh_locked(ref);
+        return ref;
+    }
+
+    // 自分の実効値を決め直し、子孫に伝える
+    void refresh_locked(NamedLogger& logger) {
+        auto threshold = logger.own_level_ ? static_cast<std::uint8_t>(*logger.own_level_)
+                                           : logger.parent_->threshold_.load(std::memory_order_relaxed);
+        const NamedTarget* target = logger.own_target_ ? logger.own_target_
+                                                       : logger.parent_->target_.load(std::memory_order_relaxed);
+        logger.target_.store(target, std::memory_order_release);
+        logger.threshold_.store(threshold, std::memory_order_relaxed);
+        for (NamedLogger* child : logger.children_) {
+            refresh_locked(*child);
+        }
+    }
+
+    mutable std::mutex mtx_;
+    std::map<std::string, std::unique_ptr<NamedLogger>, std::less<>> loggers_;
+    std::deque<NamedTarget> targets_;   // 要素のアドレスは変わらない
+};
+
+} // namespace logfunc_internal
+
+inline void NamedLogger::set_level(LogLevel level) {
+    logfunc_internal::NamedLoggerRegistry::instance().set_level(*this, level);
+}
+
+// ルートは引き継ぐ親がないので、レベル・出力先を外すと既定値に戻す
+inline void NamedLogger::clear_level() {
+    logfunc_internal::NamedLoggerRegistry::instance().set_level(
+        *this, parent_ ? std::nullopt : std::optional<LogLevel>(LogLevel::Info));
+}
+
+inline void NamedLogger::set_target(std::string_view path, Logger* logger) {
+    auto& registry = logfunc_internal::NamedLoggerRegistry::instance();
+    registry.set_target(*this, registry.intern(logger, path));
+}
+
+inline void NamedLogger::clear_target() {
+    auto& registry = logfunc_internal::NamedLoggerRegistry::instance();
+    registry.set_target(*this, parent_ ? nullptr : registry.intern(nullptr, {}));
+}
+
+/**
+ * @brief 名前付きロガーを取得する（無ければ親も含めて作る。"" はルート）
+ *
+ * 表を引くのでロックを取る。呼び出し箇所では参照を static に保持しておくこと。
+ */
+inline NamedLogger& get_logger(std::string_view name) {
+    return logfunc_internal::NamedLoggerRegistry::instance().get(name);
+}
+
+inline void log_set_level(std::string_view name, LogLevel level) {
+    get_logger(name).set_level(level);
+}
+
+inline void log_clear_level(std::string_view name) {
+    get_logger(name).clear_level();
+}
+
+inline void log_set_target(std::string_view name, std::string_view path, Logger* logger = nullptr) {
+    get_logger(name).set_target(path, logger);
+}
+
+inline void log_clear_target(std::string_view name) {
+    get_logger(name).clear_target();
+}
+
+// named の level（Trace / Debug / Info / Warn / Error / Fatal）が有効なときだけ引数を評価して書く
+#define LOGN(named, level, ...) do { \
+    if ((named).enabled(LogLevel::level)) (named).log(LogLevel::level, __VA_ARGS__); \
+} while (0)
@@ -0,0 +1,356 @@
+#pragma once
+
+// ============================================================
+// logfunc ログリーダー
+//
+// logff / logto / logkv が書いたログファイルを mmap で読み込み、
+// レコード境界（改行）で分割したチャンクを複数スレッドで並列に検索する。
+//
+//   LogReader reader("log.txt");
+//   LogQuery query;
+//   query.contains = "timeout";
+//   for (std::string_view record : reader.query(query)) { ... }
+// ============================================================
+
+#include "logfunc.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief LogReader の検索条件（指定したものすべてに一致するレコードを返す）
+ */
+struct LogQuery {
+    std::string contains;               // 部分文字列（空なら条件なし）
+    std::string level;                  // レベル名などの単語（前後が英数字でない位置に一致）
+    std::int64_t from_ms = std::numeric_limits<std::int64_t>::min();  // 時刻範囲（エポックミリ秒）
+    std::int64_t to_ms = std::numeric_limits<std::int64_t>::max();
+    std::function<bool(std::string_view)> predicate;                  // 任意の追加条件（複数スレッドから呼ばれる）
+    unsigned threads = 0;               // 検索スレッド数（0 ならハードウェアスレッド数）
+};
+
+namespace logfunc_internal {
+
+/**
+ * @brief 読み取り専用でメモリにマップしたファイル
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<std::size_t>(size.QuadPart);
+        if (size_ > 0) {
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!view) {
+                close();
+                throw std::runtime_error("Failed to map file: " + path);
+            }
+            data_ = static_cast<const char*>(view);
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0) {
+            close();
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ > 0) {
+            void* view = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (view == MAP_FAILED) {
+                close();
+                throw std::runtime_error("Failed to map file: " + path);
+            }
+            data_ = static_cast<const char*>(view);
+#ifdef MADV_SEQUENTIAL
+            ::madvise(view, size_, MADV_SEQUENTIAL);
+#endif
+        }
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const {
+        return std::string_view(data_, data_ ? size_ : 0);
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = nullptr;
+#else
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+#endif
+        data_ = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+inline bool is_word_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+// record 中に word が単語として現れるか
+inline bool contains_word(std::string_view record, std::string_view word) {
+    for (std::size_t pos = record.find(word); pos != std::string_view::npos; pos = record.find(word, pos + 1)) {
+        bool left = pos == 0 || !is_word_char(record[pos - 1]);
+        std::size_t end = pos + word.size();
+        bool right = end == record.size() || !is_word_char(record[end]);
+        if (left && right) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief レコード先頭のタイムスタンプ（logkv の Text / Logfmt / Json 形式）を読む
+ *
+ * "1717000000000 msg"、"ts=1717000000000 ..."、{"ts":1717000000000,...} の形に対応する。
+ * 先頭の数字は 12 桁以上のときだけタイムスタンプとみなす。
+ */
+inline bool record_timestamp_ms(std::string_view record, std::int64_t& out) {
+    std::size_t pos = 0;
+    std::size_t min_digits = 1;
+    if (record.compare(0, 6, "{\"ts\":") == 0) {
+        pos = 6;
+    } else if (record.compare(0, 3, "ts=") == 0) {
+        pos = 3;
+    } else {
+        min_digits = 12;
+    }
+    const char* first = record.data() + pos;
+    const char* last = record.data() + record.size();
+    auto [ptr, ec] = std::from_chars(first, last, out);
+    if (ec != std::errc() || static_cast<std::size_t>(ptr - first) < min_digits) {
+        return false;
+    }
+    return min_digits == 1 || ptr == last || *ptr == ' ';
+}
+
+/**
+ * @brief 1チャンク分の検索（レコードは改行を含まない string_view）
+ */
+class RecordMatcher {
+public:
+    RecordMatcher(const LogQuery& query, bool keep_untimed)
+        : query_(query),
+          has_time_range_(query.from_ms != std::numeric_limits<std::int64_t>::min() ||
+                          query.to_ms != std::numeric_limits<std::int64_t>::max()),
+          keep_untimed_(keep_untimed),
+          searcher_(query.contains.begin(), query.contains.end()) {}
+
+    bool operator()(std::string_view record) const {
+        if (!query_.level.empty() && !contains_word(record, query_.level)) {
+            return false;
+        }
+        if (has_time_range_) {
+            std::int64_t ts = 0;
+            if (record_timestamp_ms(record, ts)) {
+                if (ts < query_.from_ms || ts > query_.to_ms) {
+                    return false;
+                }
+            } else if (!keep_untimed_) {
+                return false;
+            }
+        }
+        return !query_.predicate || query_.predicate(record);
+    }
+
+    // chunk を走査し、一致したレコードを emit に渡す
+    template<typename Emit>
+    void scan(std::string_view chunk, Emit&& emit) const {
+        if (query_.contains.empty()) {
+            std::size_t pos = 0;
+            while (pos < chunk.size()) {
+                std::size_t end = line_end(chunk, pos);
+                std::string_view record = chunk.substr(pos, end - pos);
+                if ((*this)(record)) {
+                    emit(record);
+                }
+                pos = end + 1;
+            }
+            return;
+        }
+        // 部分文字列で候補を探し、その行だけを評価する（一致しない行は読み飛ばす）
+        if (query_.contains.find('\n') != std::string::npos) {
+            return;  // レコードをまたぐ文字列には一致しない
+        }
+        std::size_t pos = 0;
+        while (pos < chunk.size()) {
+            auto found = std::search(chunk.begin() + pos, chunk.end(), searcher_);
+            if (found == chunk.end()) {
+                break;
+            }
+            std::size_t hit = static_cast<std::size_t>(found - chunk.begin());
+            std::size_t begin = hit;
+            while (begin > pos && chunk[begin - 1] != '\n') {
+                --begin;
+            }
+            std::size_t end = line_end(chunk, hit + query_.contains.size());
+            std::string_view record = chunk.substr(begin, end - begin);
+            if ((*this)(record)) {
+                emit(record);
+            }
+            pos = end + 1;
+        }
+    }
+
+private:
+    static std::size_t line_end(std::string_view chunk, std::size_t pos) {
+        const void* nl = std::memchr(chunk.data() + pos, '\n', chunk.size() - pos);
+        return nl ? static_cast<std::size_t>(static_cast<const char*>(nl) - chunk.data()) : chunk.size();
+    }
+
+    const LogQuery& query_;
+    bool has_time_range_;
+    bool keep_untimed_;
+    // 長い部分文字列ほど読み飛ばせる量が増える
+    std::boyer_moore_horspool_searcher<std::string::const_iterator> searcher_;
+};
+
+} // namespace logfunc_internal
+
+/**
+ * @brief ログファイルの読み取り・検索
+ *
+ * ファイル全体を mmap し、改行区切りのレコードとして扱う。query() / count() は
+ * ファイルをレコード境界でチャンクに分け、スレッドごとに並列に検索する。
+ * 返す string_view は LogReader が生きている間だけ有効。
+ * 時刻範囲を指定したとき、時刻インデックス（log_enable_time_index）があれば
+ * 該当するバイト範囲だけを読む。タイムスタンプを持たないレコードは、
+ * インデックスで絞り込んだ範囲にあれば一致とみなす。
+ */
+class LogReader {
+public:
+    explicit LogReader(const std::string& path)
+        : path_(path), file_(std::make_unique<logfunc_internal::MappedFile>(path)) {}
+
+    std::string_view data() const {
+        return file_->view();
+    }
+
+    /**
+     * @brief 条件に一致するレコードをファイル内の順に返す（末尾の改行は含まない）
+     */
+    std::vector<std::string_view> query(const LogQuery& query) const {
+        std::vector<std::vector<std::string_view>> results;
+        run(query, results, [](std::vector<std::string_view>& out, std::string_view record) {
+            out.push_back(record);
+        });
+        std::size_t total = 0;
+        for (const auto& r : results) total += r.size();
+        std::vector<std::string_view> records;
+        records.reserve(total);
+        for (const auto& r : results) {
+            records.insert(records.end(), r.begin(), r.end());
+        }
+        return records;
+    }
+
+    /**
+     * @brief 条件に一致するレコード数
+     */
+    std::size_t count(const LogQuery& query) const {
+        std::vector<std::size_t> results;
+        run(query, results, [](std::size_t& n, std::string_view) { ++n; });
+        std::size_t total = 0;
+        for (std::size_t n : results) total += n;
+        return total;
+    }
+
+private:
+    // 検索対象のバイト範囲（時刻インデックスがあれば絞り込む）
+    std::string_view scan_range(const LogQuery& query, bool& indexed) const {
+        std::string_view all = data();
+        indexed = false;
+        if (query.from_ms == std::numeric_limits<std::int64_t>::min() &&
+            query.to_ms == std::numeric_limits<std::int64_t>::max()) {
+            return all;
+        }
+        auto index = logfunc_internal::TimeIndex::load(path_);
+        if (index.entries().empty()) {
+            return all;
+        }
+        indexed = true;
+        auto [first, second] = index.byte_range(query.from_ms, query.to_ms);
+        first = std::min<std::uint64_t>(first, all.size());
+        second = std::min<std::uint64_t>(second, all.size());
+        return all.substr(static_cast<std::size_t>(first), static_cast<std::size_t>(second - first));
+    }
+
+    // 範囲を threads 個のチャンクに分け、チャンクごとの結果を results に入れる
+    template<typename Result, typename Emit>
+    void run(const LogQuery& query, std::vector<Result>& results, Emit emit) const {
+        bool indexed = false;
+        std::string_view range = scan_range(query, indexed);
+        logfunc_internal::RecordMatcher matcher(query, indexed);
+
+        unsigned threads = query.threads ? query.threads : std::max(1u, std::thread::hardware_concurrency());
+        // 小さなファイルをスレッドに分けても速くならない
+        constexpr std::size_t kMinChunk = 256 * 1024;
+        std::size_t max_chunks = std::max<std::size_t>(1, range.size() / kMinChunk);
+        std::size_t chunks = std::min<std::size_t>(threads, max_chunks);
+
+        // チャンクの境界を次の改行の直後にそろえる
+        std::vector<std::size_t> bounds{0};
+        for (std::size_t i = 1; i < chunks; ++i) {
+            std::size_t pos = std::max(bounds.back(), range.size() * i / chunks);
+            std::size_t nl = range.find('\n', pos);
+            bounds.push_back(nl == std::string_view::npos ? range.size() : nl + 1);
+        }
+        bounds.push_back(range.size());
+
+        results.assign(chunks, Result{});
+        auto scan_chunk = [&](std::size_t i) {
+            std::string_view chunk = range.substr(bounds[i], bounds[i + 1] - bounds[i]);
+            matcher.scan(chunk, [&](std::string_view record) { emit(results[i], record); });
+        };
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < chunks; ++i) {
+            workers.emplace_back(scan_chunk, i);
+        }
+        scan_chunk(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::string path_;
+    std::unique_ptr<logfunc_internal::MappedFile> file_;
+};
@@ -0,0 +1,411 @@
+#pragma once
+
+// ============================================================
+// logfunc 共有メモリ転送（POSIX のみ）
+//
+// ログを書くプロセスはレコードを共有メモリのリングバッファ（shm_open + mmap）に
+// memcpy するだけで、ファイル I/O は別プロセスの書き込みデーモン
+// （examples/log_shm_writer.cpp）が行う。リングは書き込み側のプロセスが
+// 異常終了しても残るため、公開済みのレコードは失われない。
+//
+//   // 書き込み側
+//   log_set_sink("app.log", shm_ring_sink());
+//   // デーモン側
+//   ShmLogWriter writer;
+//   writer.scan();          // /dev/shm の logfunc-* を見つけて追加（Linux）
+//   writer.poll_once();     // 各リングのレコードを対象ファイルへ書く
+// ============================================================
+
+#include "logfunc.h"
+
+#ifdef _WIN32
+#error "logfunc_shm.h requires POSIX shared memory (shm_open / mmap)"
+#endif
+
+#include <csignal>
+#include <set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief 共有メモリリングの設定
+ */
+struct ShmRingOptions {
+    std::string name;                       // 共有メモリ名（"/" で始まる）。空なら "/logfunc-<pid>-<連番>"
+    std::size_t capacity = 4 * 1024 * 1024; // リングのバイト数（2 のべき乗に切り上げる）
+    bool block_when_full = false;           // 満杯のとき空きを待つ（false なら捨てて数える）
+};
+
+namespace logfunc_internal {
+
+/**
+ * @brief 共有メモリ上のリングのヘッダ（データ領域はこの直後に続く）
+ *
+ * 書き込み側 1 つ・読み出し側 1 つのリング。head / tail はリング先頭からの
+ * 通算バイト数で、レコードは [uint32 長さ][本体] を 8 バイト境界にそろえて並べる。
+ * 末尾に収まらないレコードの前には kWrapMarker を置いて先頭に戻る。
+ */
+struct ShmRingHeader {
+    static constexpr std::uint64_t kMagic = 0x4c4f4746'53484d31ULL;  // "LOGFSHM1"
+    static constexpr std::uint32_t kWrapMarker = 0xFFFFFFFFu;
+    static constexpr std::size_t kPathSize = 1024;
+
+    std::atomic<std::uint64_t> magic;       // 初期化完了後に書く
+    std::uint64_t capacity;
+    std::int64_t pid;                       // 書き込み側のプロセス
+    std::atomic<std::uint32_t> closed;      // 書き込み側が正常に閉じた
+    char target_path[kPathSize];            // 書き出し先のファイル
+
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+    alignas(64) std::atomic<std::uint64_t> dropped;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "shared memory ring needs lock-free 64-bit atomics");
+
+constexpr std::size_t kShmDataOffset = (sizeof(ShmRingHeader) + 63) & ~std::size_t(63);
+
+inline std::size_t shm_record_size(std::size_t payload) {
+    return (sizeof(std::uint32_t) + payload + 7) & ~std::size_t(7);
+}
+
+// 共有メモリをマップしたもの（破棄時に munmap する）
+class ShmMapping {
+public:
+    ShmMapping() = default;
+    ShmMapping(void* base, std::size_t size) : base_(base), size_(size) {}
+    ~ShmMapping() {
+        if (base_) ::munmap(base_, size_);
+    }
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+
+    ShmRingHeader& header() const { return *static_cast<ShmRingHeader*>(base_); }
+    char* data() const { return static_cast<char*>(base_) + kShmDataOffset; }
+
+private:
+    void* base_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+inline std::string default_shm_name() {
+    static std::atomic<unsigned> counter{0};
+    return "/logfunc-" + std::to_string(::getpid()) + "-" + std::to_string(counter.fetch_add(1));
+}
+
+/**
+ * @brief レコードを共有メモリのリングに書くシンク（書き込み側）
+ *
+ * write() はリングへの memcpy と head の release store だけを行う。
+ * リングは破棄時に閉じた印を付けるだけで、削除はデーモン（ShmLogWriter）が行う。
+ */
+class ShmRingSink : public LogSink {
+public:
+    ShmRingSink(const std::string& path, const ShmRingOptions& options)
+        : name_(options.name.empty() ? default_shm_name() : options.name),
+          block_when_full_(options.block_when_full) {
+        // デーモンは別の作業ディレクトリで動くので絶対パスで渡す
+        std::error_code ec;
+        std::string target_path = std::filesystem::absolute(path, ec).string();
+        if (ec) target_path = path;
+        if (target_path.size() >= ShmRingHeader::kPathSize) {
+            throw std::runtime_error("log path too long for shared memory ring: " + target_path);
+        }
+        std::size_t capacity = 4096;
+        while (capacity < options.capacity) capacity <<= 1;
+        std::size_t size = kShmDataOffset + capacity;
+
+        int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open failed: " + name_ + ": " + std::strerror(errno));
+        }
+        void* base = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+            base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            ::shm_unlink(name_.c_str());
+            throw std::runtime_error("failed to map shared memory ring: " + name_);
+        }
+        map_ = std::make_unique<ShmMapping>(base, size);
+
+        // ftruncate した領域は 0 で埋まっているので、atomic はそのまま 0 として使える
+        auto& h = map_->header();
+        h.capacity = capacity;
+        h.pid = static_cast<std::int64_t>(::getpid());
+        std::memcpy(h.target_path, target_path.c_str(), target_path.size() + 1);
+        h.magic.store(ShmRingHeader::kMagic, std::memory_order_release);
+        capacity_ = capacity;
+    }
+
+    ~ShmRingSink() override {
+        map_->header().closed.store(1, std::memory_order_release);
+    }
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    void write(std::string_view data) override {
+        auto& h = map_->header();
+        std::size_t need = shm_record_size(data.size());
+        if (need > capacity_ / 2) {
+            h.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::uint64_t head = h.head.load(std::memory_order_relaxed);
+        std::size_t pos = static_cast<std::size_t>(head & (capacity_ - 1));
+        std::size_t contiguous = capacity_ - pos;
+        std::size_t total = contiguous < need ? contiguous + need : need;
+
+        while (capacity_ - (head - h.tail.load(std::memory_order_acquire)) < total) {
+            if (!block_when_full_) {
+                h.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        char* data_area = map_->data();
+        if (contiguous < need) {
+            std::memcpy(data_area + pos, &ShmRingHeader::kWrapMarker, sizeof(std::uint32_t));
+            head += contiguous;
+            pos = 0;
+        }
+        auto length = static_cast<std::uint32_t>(data.size());
+        std::memcpy(data_area + pos, &length, sizeof(length));
+        std::memcpy(data_area + pos + sizeof(length), data.data(), data.size());
+        h.head.store(head + need, std::memory_order_release);
+    }
+
+    // レコードは write() の時点で公開済み
+    void flush() override {}
+
+private:
+    std::string name_;
+    bool block_when_full_;
+    std::size_t capacity_ = 0;
+    std::unique_ptr<ShmMapping> map_;
+};
+
+} // namespace logfunc_internal
+
+/**
+ * @brief 既存の共有メモリリングを開いて読み出す（デーモン側）
+ */
+class ShmRingReader {
+public:
+    explicit ShmRingReader(std::string name) : name_(std::move(name)) {
+        int fd = ::shm_open(name_.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open failed: " + name_ + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        void* base = MAP_FAILED;
+        std::size_t size = 0;
+        if (::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) > logfunc_internal::kShmDataOffset) {
+            size = static_cast<std::size_t>(st.st_size);
+            base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("not a logfunc shared memory ring: " + name_);
+        }
+        map_ = std::make_unique<logfunc_internal::ShmMapping>(base, size);
+        auto& h = map_->header();
+        // 容量は 2 のべき乗（位置をマスクで求める）、出力先は NUL で終わること
+        if (h.magic.load(std::memory_order_acquire) != logfunc_internal::ShmRingHeader::kMagic ||
+            logfunc_internal::kShmDataOffset + h.capacity != size ||
+            h.capacity < 4096 || (h.capacity & (h.capacity - 1)) != 0 ||
+            std::memchr(h.target_path, '\0', sizeof(h.target_path)) == nullptr) {
+            throw std::runtime_error("not a logfunc shared memory ring: " + name_);
+        }
+        capacity_ = static_cast<std::size_t>(h.capacity);
+    }
+
+    const std::string& name() const { return name_; }
+    std::string target_path() const { return map_->header().target_path; }
+    std::uint64_t dropped() const { return map_->header().dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 公開済みのレコードをすべて emit(std::string_view) に渡し、件数を返す
+     *
+     * head / tail や長さが書き込み側の規則と合わない場合はそこで止め、corrupted() を立てる
+     * （壊れた、または別のプログラムのリングでマップの外を読まないため）。
+     */
+    template<typename Emit>
+    std::size_t drain(Emit&& emit) {
+        auto& h = map_->header();
+        const char* data_area = map_->data();
+        std::uint64_t tail = h.tail.load(std::memory_order_relaxed);
+        std::uint64_t head = h.head.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        if (corrupted_ || tail > head || head - tail > capacity_ || tail % 8 != 0) {
+            corrupted_ = true;
+            return 0;
+        }
+        while (tail < head) {
+            std::size_t pos = static_cast<std::size_t>(tail & (capacity_ - 1));
+            std::uint32_t length = 0;
+            std::memcpy(&length, data_area + pos, sizeof(length));
+            if (length == logfunc_internal::ShmRingHeader::kWrapMarker) {
+                if (pos == 0 || tail + (capacity_ - pos) > head) {
+                    corrupted_ = true;
+                    break;
+                }
+                tail += capacity_ - pos;
+                continue;
+            }
+            // レコードは折り返さずに置かれ、公開済みの範囲に収まる
+            std::size_t size = logfunc_internal::shm_record_size(length);
+            if (length > capacity_ / 2 || pos + size > capacity_ || tail + size > head) {
+                corrupted_ = true;
+                break;
+            }
+            emit(std::string_view(data_area + pos + sizeof(length), length));
+            tail += size;
+            ++count;
+        }
+        h.tail.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief drain() が規則に合わない内容を見つけた（以後は読まない）
+     */
+    bool corrupted() const {
+        return corrupted_;
+    }
+
+    /**
+     * @brief 書き込み側がもう書かない（正常に閉じた、またはプロセスが終了した）
+     */
+    bool producer_gone() const {
+        auto& h = map_->header();
+        if (h.closed.load(std::memory_order_acquire)) {
+            return true;
+        }
+        return ::kill(static_cast<pid_t>(h.pid), 0) != 0 && errno == ESRCH;
+    }
+
+    // 共有メモリ名を削除する（マップは破棄まで有効）
+    void unlink() {
+        ::shm_unlink(name_.c_str());
+    }
+
+private:
+    std::string name_;
+    std::size_t capacity_ = 0;
+    bool corrupted_ = false;
+    std::unique_ptr<logfunc_internal::ShmMapping> map_;
+};
+
+/**
+ * @brief 複数の共有メモリリングをファイルへ書き出す（書き込みデーモンの本体）
+ *
+ * 各リングのレコードを、リングに記録された出力先へ Logger 経由で書く。
+ * 書き込み側がいなくなったリングは読み切ってから削除する。
+ */
+class ShmLogWriter {
+public:
+    explicit ShmLogWriter(Logger& logger) : logger_(logger) {}
+    ShmLogWriter() : logger_(get_default_logger()) {}
+
+    // 共有メモリ名を追加する（既に追加済みなら何もしない）
+    bool add(const std::string& name) {
+        if (rejected_.count(name) != 0) return false;
+        for (const auto& ring : rings_) {
+            if (ring->name() == name) return false;
+        }
+        try {
+            rings_.push_back(std::make_unique<ShmRingReader>(name));
+            last_dropped_.push_back(0);
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "[logfunc] " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    /**
+     * @brief /dev/shm から prefix で始まるリングを探して追加する（Linux）
+     */
+    std::size_t scan(const std::string& prefix = "logfunc-") {
+        std::size_t added = 0;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator("/dev/shm", ec)) {
+            std::string file = entry.path().filename().string();
+            if (file.compare(0, prefix.size(), prefix) == 0 && add("/" + file)) {
+                ++added;
+            }
+        }
+        return added;
+    }
+
+    /**
+     * @brief 全リングを1回ずつ読み出して書き込み、書いたレコード数を返す
+     */
+    std::size_t poll_once() {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < rings_.size();) {
+            auto& ring = *rings_[i];
+            // 読み出し前に判定する（判定後に公開されたレコードも今回読み切る）
+            bool gone = ring.producer_gone();
+            std::string path = ring.target_path();
+            total += ring.drain([&](std::string_view record) { logger_.write_atomic(path, record); });
+            if (ring.corrupted()) {
+                // 他のリングの書き出しを止めないよう、このリングだけを外す（scan でも追加し直さない）
+                std::cerr << "[logfunc] Warning: shared memory ring " << ring.name()
+                          << " is corrupted; no longer reading it" << std::endl;
+                rejected_.insert(ring.name());
+                rings_.erase(rings_.begin() + static_cast<std::ptrdiff_t>(i));
+                last_dropped_.erase(last_dropped_.begin() + static_cast<std::ptrdiff_t>(i));
+                continue;
+            }
+
+            std::uint64_t dropped = ring.dropped();
+            if (dropped != last_dropped_[i]) {
+                logger_.log_to(path, "[logfunc] shared memory ring ", ring.name(), " dropped ",
+                               dropped - last_dropped_[i], " records\n");
+                last_dropped_[i] = dropped;
+            }
+            if (gone) {
+                ring.unlink();
+                rings_.erase(rings_.begin() + static_cast<std::ptrdiff_t>(i));
+                last_dropped_.erase(last_dropped_.begin() + static_cast<std::ptrdiff_t>(i));
+                continue;
+            }
+            ++i;
+        }
+        if (total > 0) {
+            logger_.flush();
+        }
+        return total;
+    }
+
+    std::size_t ring_count() const {
+        return rings_.size();
+    }
+
+private:
+    Logger& logger_;
+    std::vector<std::unique_ptr<ShmRingReader>> rings_;
+    std::vector<std::uint64_t> last_dropped_;
+    std::set<std::string> rejected_;   // 壊れていたため外したリング
+};
+
+/**
+ * @brief 共有メモリリングに書くシンクのファクトリ（Logger::set_sink / log_set_sink に渡す）
+ *
+ * ファイルを開くたびに新しいリングを作る。options.name を指定した場合、
+ * 同じ名前のリングが残っていると作成に失敗する。
+ */
+inline Logger::SinkFactory shm_ring_sink(ShmRingOptions options = {}) {
+    return [options](const std::string& path) -> std::unique_ptr<Logger::Sink> {
+        return std::make_unique<logfunc_internal::ShmRingSink>(path, options);
+    };
+}
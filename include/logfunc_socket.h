@@ -0,0 +1,352 @@
+#pragma once
+
+// ============================================================
+// logfunc Unix ドメインソケットシンク（POSIX のみ）
+//
+// レコードを Unix ドメインソケット（/dev/log の syslog / journald など）に送る。
+// 書き込み側はレコードを上限付きのキューに積むだけで、送信は専用スレッドが
+// まとめて行う（データグラムは sendmmsg、ストリームは複数 iovec の sendmsg）。
+// 接続が切れた場合は reconnect_interval ごとに接続し直し、それまでのレコードは
+// キューに残す。キューが buffer_bytes を超える分のレコードは捨てて数える。
+//
+//   SocketSinkOptions opts;
+//   opts.syslog = true;
+//   log_set_sink(get_default_logger().get_log_path(), unix_socket_sink(opts));
+//   logff("started\n");   // /dev/log に "<14>logfunc[1234]: started" が届く
+// ============================================================
+
+#include "logfunc.h"
+
+#ifdef _WIN32
+#error "logfunc_socket.h requires Unix domain sockets"
+#endif
+
+#include <condition_variable>
+#include <deque>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief ソケットの種類
+ */
+enum class SocketMode {
+    Datagram,   // 1 レコード = 1 データグラム（末尾の改行は除く）
+    Stream      // 改行区切りのバイト列
+};
+
+/**
+ * @brief Unix ドメインソケットシンクの設定
+ */
+struct SocketSinkOptions {
+    std::string socket_path = "/dev/log";
+    SocketMode mode = SocketMode::Datagram;
+    bool syslog = false;                       // 各レコードに "<PRI>TAG[PID]: " を付ける（RFC 3164 のローカル形式）
+    int facility = 1;                          // syslog の facility（1 = user）
+    int severity = 6;                          // syslog の severity（6 = info）
+    std::string tag = "logfunc";
+    std::size_t batch_records = 64;            // 1 回の送信でまとめる最大レコード数
+    std::size_t buffer_bytes = 1024 * 1024;    // 送信待ちレコードの上限
+    std::chrono::milliseconds reconnect_interval{500};  // 再接続の間隔（送信のタイムアウトにも使う）
+};
+
+namespace logfunc_internal {
+
+/**
+ * @brief Unix ドメインソケットへ送るシンク
+ *
+ * write() はキューに積むだけで、ソケットには触れない。ソケットの操作は
+ * すべて送信スレッドが行う。送信中に接続が切れたレコードは、接続し直した後に
+ * 先頭から送り直す（ストリームでは途中まで届いた行が受信側に残りうる）。
+ */
+class UnixSocketSink : public LogSink {
+public:
+    static constexpr std::size_t kMaxBatch = 1024;   // IOV_MAX の最小保証値
+
+    explicit UnixSocketSink(SocketSinkOptions options) : options_(std::move(options)) {
+        if (options_.socket_path.empty() || options_.socket_path.size() >= sizeof(sockaddr_un{}.sun_path)) {
+            throw std::runtime_error("invalid unix socket path: " + options_.socket_path);
+        }
+        options_.batch_records = std::clamp<std::size_t>(options_.batch_records, 1, kMaxBatch);
+        if (options_.syslog) {
+            int priority = options_.facility * 8 + options_.severity;
+            header_ = "<" + std::to_string(priority) + ">" + options_.tag + "[" +
+                      std::to_string(::getpid()) + "]: ";
+        }
+        sender_ = std::thread([this] { run(); });
+    }
+
+    ~UnixSocketSink() override {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        sender_.join();
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    UnixSocketSink(const UnixSocketSink&) = delete;
+    UnixSocketSink& operator=(const UnixSocketSink&) = delete;
+
+    void write(std::string_view data) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (queued_bytes_ + data.size() > options_.buffer_bytes) {
+            ++dropped_;
+            return;
+        }
+        queue_.emplace_back(data);
+        queued_bytes_ += data.size();
+        if (sender_waiting_) {
+            cv_.notify_one();
+        }
+    }
+
+    // キューが空になるか、接続できずに送信を諦めるまで待つ
+    void flush() override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        std::uint64_t failures = failures_;
+        retry_now_ = true;
+        cv_.notify_one();
+        idle_cv_.wait(lock, [&] {
+            return (queue_.empty() && dropped_ == 0 && !in_flight_) || failures_ != failures;
+        });
+    }
+
+private:
+#ifdef MSG_NOSIGNAL
+    static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int kSendFlags = 0;
+#endif
+
+    void run() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true) {
+            if (queue_.empty() && dropped_ == 0) {
+                idle_cv_.notify_all();
+                if (stop_) break;
+                sender_waiting_ = true;
+                cv_.wait(lock, [&] { return stop_ || !queue_.empty() || dropped_ > 0; });
+                sender_waiting_ = false;
+                continue;
+            }
+
+            // 捨てた件数は次のバッチの先頭で知らせる
+            batch.clear();
+            if (dropped_ > 0) {
+                batch.push_back("[logfunc] socket sink dropped " + std::to_string(dropped_) + " records\n");
+                dropped_ = 0;
+            }
+            while (batch.size() < options_.batch_records && !queue_.empty()) {
+                queued_bytes_ -= queue_.front().size();
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            in_flight_ = true;
+            lock.unlock();
+
+            std::size_t sent = 0;
+            bool was_connected = fd_ >= 0;
+            if (was_connected || connect_socket()) {
+                sent = send_batch(batch);
+            }
+            // 受信側が再起動した場合などは、すぐに接続し直して 1 度だけ送り直す
+            if (sent == 0 && was_connected && fd_ < 0 && connect_socket()) {
+                sent = send_batch(batch);
+            }
+
+            lock.lock();
+            in_flight_ = false;
+            // 送れなかったレコードはキューの先頭に戻す
+            for (std::size_t i = batch.size(); i-- > sent;) {
+                queued_bytes_ += batch[i].size();
+                queue_.push_front(std::move(batch[i]));
+            }
+            if (sent == 0) {
+                ++failures_;
+                idle_cv_.notify_all();
+                if (stop_) {
+                    break;   // 終了時に送れないものは諦める
+                }
+                retry_now_ = false;
+                cv_.wait_for(lock, options_.reconnect_interval, [&] { return stop_ || retry_now_; });
+            }
+        }
+    }
+
+    bool connect_socket() {
+        int type = options_.mode == SocketMode::Datagram ? SOCK_DGRAM : SOCK_STREAM;
+        int fd = ::socket(AF_UNIX, type, 0);
+        if (fd < 0) {
+            return false;
+        }
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        // 受信側が詰まっていても送信スレッドが止まり続けないようにする
+        auto ms = options_.reconnect_interval.count();
+        timeval timeout{};
+        timeout.tv_sec = static_cast<decltype(timeout.tv_sec)>(ms / 1000);
+        timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>((ms % 1000) * 1000);
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, options_.socket_path.c_str(), options_.socket_path.size() + 1);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        fd_ = fd;
+        return true;
+    }
+
+    // batch の先頭から送れたレコード数を返す。接続が切れていればソケットを閉じる
+    std::size_t send_batch(const std::vector<std::string>& batch) {
+        frames_.resize(batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            std::string_view body = batch[i];
+            if (!body.empty() && body.back() == '\n') {
+                body.remove_suffix(1);
+            }
+            auto& frame = frames_[i];
+            frame.assign(header_);
+            frame.append(body);
+            if (options_.mode == SocketMode::Stream) {
+                frame.push_back('\n');
+            }
+        }
+
+        std::size_t sent = options_.mode == SocketMode::Datagram ? send_datagrams() : send_stream();
+        if (sent < frames_.size() && fd_ >= 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        return sent;
+    }
+
+    std::size_t send_datagrams() {
+        std::size_t count = frames_.size();
+        iov_.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            iov_[i].iov_base = frames_[i].data();
+            iov_[i].iov_len = frames_[i].size();
+        }
+        std::size_t done = 0;
+#ifdef __linux__
+        msgs_.assign(count, mmsghdr{});
+        for (std::size_t i = 0; i < count; ++i) {
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+        while (done < count) {
+            int n = ::sendmmsg(fd_, msgs_.data() + done, static_cast<unsigned>(count - done), kSendFlags);
+            if (n > 0) {
+                done += static_cast<std::size_t>(n);
+            } else if (n < 0 && errno == EMSGSIZE) {
+                ++done;   // 受信側の上限を超えるレコードは送れないので飛ばす
+            } else if (n < 0 && errno != EINTR) {
+                break;
+            }
+        }
+#else
+        while (done < count) {
+            ssize_t n = ::send(fd_, iov_[done].iov_base, iov_[done].iov_len, kSendFlags);
+            if (n >= 0 || errno == EMSGSIZE) {
+                ++done;
+            } else if (errno != EINTR) {
+                break;
+            }
+        }
+#endif
+        return done;
+    }
+
+    std::size_t send_stream() {
+        std::size_t count = frames_.size();
+        std::size_t done = 0;
+        std::size_t offset = 0;   // frames_[done] のうち送信済みのバイト数
+        while (done < count) {
+            iov_.resize(count - done);
+            for (std::size_t i = done; i < count; ++i) {
+                std::size_t skip = i == done ? offset : 0;
+                iov_[i - done].iov_base = frames_[i].data() + skip;
+                iov_[i - done].iov_len = frames_[i].size() - skip;
+            }
+            msghdr msg{};
+            msg.msg_iov = iov_.data();
+            msg.msg_iovlen = static_cast<decltype(msg.msg_iovlen)>(iov_.size());
+            ssize_t n = ::sendmsg(fd_, &msg, kSendFlags);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                // 途中まで送ったレコードの続きは送れないので、接続ごと捨てて送り直す
+                if (offset > 0) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+                break;
+            }
+            auto remaining = static_cast<std::size_t>(n);
+            while (remaining > 0) {
+                std::size_t left = frames_[done].size() - offset;
+                if (remaining >= left) {
+                    remaining -= left;
+                    ++done;
+                    offset = 0;
+                } else {
+                    offset += remaining;
+                    remaining = 0;
+                }
+            }
+        }
+        return done;
+    }
+
+    SocketSinkOptions options_;
+    std::string header_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;        // 送信スレッドを起こす
+    std::condition_variable idle_cv_;   // flush() を起こす
+    std::deque<std::string> queue_;
+    std::size_t queued_bytes_ = 0;
+    std::uint64_t dropped_ = 0;
+    std::uint64_t failures_ = 0;
+    bool in_flight_ = false;
+    bool sender_waiting_ = false;
+    bool retry_now_ = false;
+    bool stop_ = false;
+
+    // 以下は送信スレッドだけが触る
+    int fd_ = -1;
+    std::vector<std::string> frames_;
+    std::vector<iovec> iov_;
+#ifdef __linux__
+    std::vector<mmsghdr> msgs_;
+#endif
+
+    std::thread sender_;
+};
+
+} // namespace logfunc_internal
+
+/**
+ * @brief Unix ドメインソケットに送るシンクのファクトリ（Logger::set_sink / log_set_sink に渡す）
+ *
+ * ログのパスはシンクを選ぶためのキーとしてだけ使い、送信先は options.socket_path で決まる。
+ */
+inline Logger::SinkFactory unix_socket_sink(SocketSinkOptions options = {}) {
+    return [options](const std::string&) -> std::unique_ptr<Logger::Sink> {
+        return std::make_unique<logfunc_internal::UnixSocketSink>(options);
+    };
+}
@@ -94,7 +94,7 @@ std::string Logger::get_input_path() const {
     return input_file_path_;
 }
 
-std::ofstream& Logger::get_or_open(std::string_view path) {
+std::ostream& Logger::get_or_open(std::string_view path) {
     std::lock_guard<std::mutex> lock(mtx_);
     std::string path_str{path};
     return get_or_open_internal(path_str);